@@ -20,17 +20,37 @@
 #include "baseloop.h"
 #include "logger.h"
 #include "appl.h"
-#include <dirent.h>
 #include <iomanip>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 using namespace std;
 
 extern Logger& L;
 extern Appl& A;
 
+/**
+ * @brief Return the number of bytes currently allocated on the heap.
+ * @return the number of bytes currently allocated on the heap, or 0 if unknown.
+ */
+static size_t getHeapUsage()
+{
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+	return mallinfo2().uordblks;
+#else
+	return (unsigned int)mallinfo().uordblks;
+#endif
+#else
+	return 0;
+#endif
+}
+
 BaseLoop::BaseLoop()
 {
 	// create commands DB
+	size_t heapBefore = getHeapUsage();
 	m_templates = new DataFieldTemplates();
 	m_messages = new MessageMap();
 
@@ -51,7 +71,13 @@ BaseLoop::BaseLoop()
 	L.log(bas, event, "updates DB: %d ", m_messages->size(true));
 	L.log(bas, event, "polling DB: %d ", m_messages->sizePoll());
 
-	m_ownAddress = A.getOptVal<int>("address") & 0xff;
+	size_t strings, references, stringBytes;
+	StringPool::getStats(strings, references, stringBytes);
+	L.log(bas, event, "memory: %lu kB before, %lu kB after loading, %lu distinct of %lu strings with %lu bytes",
+		(unsigned long)(heapBefore / 1024), (unsigned long)(getHeapUsage() / 1024),
+		(unsigned long)strings, (unsigned long)references, (unsigned long)stringBytes);
+
+	const unsigned char ownAddress = A.getOptVal<int>("address") & 0xff;
 	const bool answer = A.getOptVal<bool>("answer");
 
 	const bool logRaw = A.getOptVal<bool>("lograwdata");
@@ -72,20 +98,58 @@ BaseLoop::BaseLoop()
 	} else
 		m_pollActive = true;
 
-	// create Port
-	m_port = new Port(A.getOptVal<const char*>("device"), A.getOptVal<bool>("nodevicecheck"), logRaw, &BaseLoop::logRaw, dumpRaw, dumpRawFile, dumpRawMaxSize);
-	m_port->open();
-
-	if (m_port->isOpen() == false)
-		L.log(bus, error, "can't open %s", A.getOptVal<const char*>("device"));
+	// create Port and BusHandler for each device, all sharing the same messages
+	string devices = A.getOptVal<const char*>("device");
+	for (size_t pos = 0; pos <= devices.length(); ) {
+		size_t end = devices.find(',', pos);
+		if (end == string::npos)
+			end = devices.length();
+		string device = devices.substr(pos, end-pos);
+		pos = end+1;
+
+		unsigned char address = ownAddress;
+		size_t addressPos = device.rfind('@');
+		if (addressPos != string::npos) {
+			address = (unsigned char)strtoul(device.substr(addressPos+1).c_str(), NULL, 16);
+			device = device.substr(0, addressPos);
+		}
+		if (device.empty() == true) {
+			L.log(bus, error, "empty device name, bus skipped");
+			continue;
+		}
+		if (isMaster(address) == false) {
+			L.log(bus, error, "invalid address %2.2x for %s, bus skipped", address, device.c_str());
+			continue;
+		}
 
-	// create BusHandler
-	m_busHandler = new BusHandler(m_port, m_messages,
-			m_ownAddress, answer,
-			busLostRetries, failedSendRetries,
-			busAcquireWaitTime, slaveRecvTimeout,
-			lockCount, pollInterval);
-	m_busHandler->start("bushandler");
+		// further buses dump to the file name with the bus number appended
+		ostringstream dumpFile;
+		dumpFile << dumpRawFile;
+		if (m_busHandlers.empty() == false)
+			dumpFile << "." << m_busHandlers.size();
+
+		Port* port = new Port(device, A.getOptVal<bool>("nodevicecheck"), logRaw, &BaseLoop::logRaw, dumpRaw, dumpFile.str().c_str(), dumpRawMaxSize, A.getOptVal<bool>("dumpcapture"),
+			A.getOptVal<float>("replayspeed"), A.getOptVal<bool>("replayecho"));
+		port->open();
+
+		if (port->isOpen() == false)
+			L.log(bus, error, "can't open %s", device.c_str());
+
+		// polled messages are not bound to a bus, so only the first one polls
+		BusHandler* busHandler = new BusHandler(port, m_busHandlers.size(), m_messages,
+				address, answer,
+				busLostRetries, failedSendRetries,
+				busAcquireWaitTime, slaveRecvTimeout,
+				lockCount, m_busHandlers.empty() == true ? pollInterval : 0, A.getOptVal<bool>("readthread"),
+				A.getOptVal<bool>("burstsend"));
+		busHandler->start("bushandler");
+
+		m_ownAddresses.push_back(address);
+		m_ports.push_back(port);
+		m_busHandlers.push_back(busHandler);
+	}
+	if (m_busHandlers.size() > 1)
+		L.log(bas, event, "buses: %lu", (unsigned long)m_busHandlers.size());
 
 	// create network
 	m_network = new Network(A.getOptVal<bool>("localhost"), &m_netQueue);
@@ -97,14 +161,14 @@ BaseLoop::~BaseLoop()
 	if (m_network != NULL)
 		delete m_network;
 
-	if (m_busHandler != NULL) {
-		m_busHandler->stop();
-		m_busHandler->join();
-		delete m_busHandler;
-	}
+	for (vector<BusHandler*>::iterator it = m_busHandlers.begin(); it != m_busHandlers.end(); it++)
+		(*it)->stop();
 
-	if (m_port != NULL)
-		delete m_port;
+	for (size_t index = 0; index < m_busHandlers.size(); index++) {
+		m_busHandlers[index]->join();
+		delete m_busHandlers[index];
+		delete m_ports[index];
+	}
 
 	if (m_messages != NULL)
 		delete m_messages;
@@ -115,44 +179,36 @@ BaseLoop::~BaseLoop()
 
 result_t BaseLoop::readConfigFiles(const string path, const string extension)
 {
-	DIR* dir = opendir(path.c_str());
-
-	if (dir == NULL)
-		return RESULT_ERR_NOTFOUND;
-
-	dirent* d = readdir(dir);
-
-	while (d != NULL) {
-		if (d->d_type == DT_DIR) {
-			string fn = d->d_name;
-
-			if (fn != "." && fn != "..") {
-				const string p = path + "/" + d->d_name;
-				result_t result = readConfigFiles(p, extension);
-				if (result != RESULT_OK)
-					return result;
-			}
-		} else if (d->d_type == DT_REG) {
-			string fn = d->d_name;
-
-			if (fn.find(extension, (fn.length() - extension.length())) != string::npos
-				&& fn != "_types" + extension) {
-				const string p = path + "/" + d->d_name;
-				result_t result = m_messages->readFromFile(p, m_templates);
-				if (result != RESULT_OK)
-					return result;
-			}
+	vector<MessageList*> lists;
+	result_t result = MessageList::collect(path, extension, lists);
+
+	// parse the files concurrently, then merge them in the order collected
+	size_t threads = MessageList::readAll(lists, m_templates);
+	if (lists.empty() == false)
+		L.log(bas, trace, "parsed %lu config files with %lu threads",
+			(unsigned long)lists.size(), (unsigned long)threads);
+
+	result_t mergeResult = RESULT_OK;
+	for (vector<MessageList*>::iterator it = lists.begin(); it != lists.end(); it++) {
+		MessageList* list = *it;
+		if (mergeResult == RESULT_OK) {
+			L.log(bas, debug, "parsed %s: %lu messages in %lu us",
+				list->getFilename().c_str(), (unsigned long)list->size(), list->getDuration());
+			mergeResult = m_messages->merge(*list);
 		}
-
-		d = readdir(dir);
+		delete list;
 	}
-	closedir(dir);
 
-	return RESULT_OK;
-};
+	return mergeResult != RESULT_OK ? mergeResult : result;
+}
 
 void BaseLoop::start()
 {
+	if (m_busHandlers.empty() == true) {
+		L.log(bas, error, "no valid device");
+		return;
+	}
+
 	for (;;) {
 		string result;
 
@@ -206,6 +262,19 @@ string BaseLoop::decodeMessage(const string& data)
 	while (getline(stream, token, ' ') != 0)
 		cmd.push_back(token);
 
+	// select the bus by optional prefix '@N'
+	size_t bus = 0;
+	if (cmd.size() > 0 && cmd[0].length() > 1 && cmd[0][0] == '@') {
+		char* strEnd = NULL;
+		bus = strtoul(cmd[0].c_str()+1, &strEnd, 10);
+		if (strEnd == NULL || *strEnd != 0 || bus >= m_busHandlers.size())
+			return "bus not found";
+		cmd.erase(cmd.begin());
+	}
+	const unsigned char ownAddress = m_ownAddresses[bus];
+	Port* port = m_ports[bus];
+	BusHandler* busHandler = m_busHandlers[bus];
+
 	if (cmd.size() == 0)
 		return "command missing";
 
@@ -227,9 +296,10 @@ string BaseLoop::decodeMessage(const string& data)
 
 		if (message != NULL) {
 
-			if (m_pollActive == true && message->getPollPriority() > 0) {
+			// only the first bus polls, so the others always read
+			if (m_pollActive == true && bus == 0 && message->getPollPriority() > 0) {
 				// get polldata
-				token = message->getLastValue();
+				token = message->getLastValue(bus);
 				if (token.empty() == false) {
 					result << token;
 				} else {
@@ -239,8 +309,7 @@ string BaseLoop::decodeMessage(const string& data)
 			}
 
 			SymbolString master;
-			istringstream input;
-			result_t ret = message->prepareMaster(m_ownAddress, master, input);
+			result_t ret = message->prepareMaster(ownAddress, master);
 			if (ret != RESULT_OK) {
 				L.log(bas, error, " prepare read: %s", getResultCode(ret));
 				result << getResultCode(ret);
@@ -250,11 +319,11 @@ string BaseLoop::decodeMessage(const string& data)
 
 			// send message
 			SymbolString slave;
-			ret = m_busHandler->sendAndWait(master, slave);
+			ret = busHandler->sendAndWait(master, slave);
 
 			if (ret == RESULT_OK) {
 				// TODO reduce to requested variable only
-				ret = message->decode(pt_slaveData, slave, result); // decode data
+				ret = message->decode(pt_slaveData, slave, result, false, UI_FIELD_SEPARATOR, bus); // decode data
 			}
 			if (ret != RESULT_OK) {
 				L.log(bas, error, " read: %s", getResultCode(ret));
@@ -277,8 +346,7 @@ string BaseLoop::decodeMessage(const string& data)
 		if (message != NULL) {
 
 			SymbolString master;
-			istringstream input(cmd[3]);
-			result_t ret = message->prepareMaster(m_ownAddress, master, input);
+			result_t ret = message->prepareMaster(ownAddress, master, cmd[3]);
 			if (ret != RESULT_OK) {
 				L.log(bas, error, " prepare write: %s", getResultCode(ret));
 				result << getResultCode(ret);
@@ -288,13 +356,13 @@ string BaseLoop::decodeMessage(const string& data)
 
 			// send message
 			SymbolString slave;
-			ret = m_busHandler->sendAndWait(master, slave);
+			ret = busHandler->sendAndWait(master, slave);
 
 			if (ret == RESULT_OK) {
 				if (master[1] == BROADCAST || isMaster(master[1]))
 					result << "done";
 				else {
-					ret = message->decode(pt_slaveData, slave, result); // decode data
+					ret = message->decode(pt_slaveData, slave, result, false, UI_FIELD_SEPARATOR, bus); // decode data
 					if (ret == RESULT_OK && result.str().empty() == true)
 						result << "done";
 				}
@@ -322,7 +390,7 @@ string BaseLoop::decodeMessage(const string& data)
 			message = m_messages->find(cmd[1], cmd[2], false, true);
 
 		if (message != NULL) {
-			token = message->getLastValue();
+			token = message->getLastValue(bus);
 			if (token.empty() == false) {
 				result << token;
 			} else {
@@ -342,16 +410,23 @@ string BaseLoop::decodeMessage(const string& data)
 
 		{
 			cmd[1].erase(remove_if(cmd[1].begin(), cmd[1].end(), ::isspace), cmd[1].end());
-			string src;
-			ostringstream msg;
-			msg << hex << setw(2) << setfill('0') << static_cast<unsigned>(m_ownAddress);
-			msg << cmd[1];
-			SymbolString master(msg.str());
+			if (cmd[1].length() > 2*(4+MAX_DATA_LENGTH)) {
+				result << getResultCode(RESULT_ERR_OVERFLOW);
+				break;
+			}
+			SymbolString unescaped;
+			unescaped.push_back(ownAddress, false, false);
+			result_t ret = unescaped.parseHex(cmd[1], false, false);
+			if (ret != RESULT_OK) {
+				result << getResultCode(ret);
+				break;
+			}
+			SymbolString master(unescaped, true);
 			L.log(bas, event, " hex msg: %s", master.getDataStr().c_str());
 
 			// send message
 			SymbolString slave;
-			result_t ret = m_busHandler->sendAndWait(master, slave);
+			ret = busHandler->sendAndWait(master, slave);
 
 			if (ret == RESULT_OK) {
 				if (master[1] == BROADCAST || isMaster(master[1]))
@@ -370,7 +445,7 @@ string BaseLoop::decodeMessage(const string& data)
 
 	case ct_scan:
 		if (cmd.size() == 1) {
-			result_t ret = m_busHandler->startScan();
+			result_t ret = busHandler->startScan();
 			if (ret != RESULT_OK) {
 				L.log(bas, error, " scan: %s", getResultCode(ret));
 				result << getResultCode(ret);
@@ -381,7 +456,7 @@ string BaseLoop::decodeMessage(const string& data)
 		}
 
 		if (strcasecmp(cmd[1].c_str(), "FULL") == 0) {
-			result_t ret = m_busHandler->startScan(true);
+			result_t ret = busHandler->startScan(true);
 			if (ret != RESULT_OK) {
 				L.log(bas, error, " full scan: %s", getResultCode(ret));
 				result << getResultCode(ret);
@@ -392,7 +467,7 @@ string BaseLoop::decodeMessage(const string& data)
 		}
 
 		if (strcasecmp(cmd[1].c_str(), "RESULT") == 0) {
-			m_busHandler->formatScanResult(result);
+			busHandler->formatScanResult(result);
 			break;
 		}
 
@@ -432,7 +507,7 @@ string BaseLoop::decodeMessage(const string& data)
 			break;
 		}
 
-		m_port->setLogRaw(!m_port->getLogRaw());
+		port->setLogRaw(!port->getLogRaw());
 		result << "done";
 		break;
 
@@ -442,7 +517,9 @@ string BaseLoop::decodeMessage(const string& data)
 			break;
 		}
 
-		m_port->setDumpRaw(!m_port->getDumpRaw());
+		if (port->getDumpRawDropped() > 0)
+			L.log(bas, error, " dump: %lu bytes dropped in total", port->getDumpRawDropped());
+		port->setDumpRaw(!port->getDumpRaw());
 		result << "done";
 		break;
 
@@ -469,7 +546,7 @@ string BaseLoop::decodeMessage(const string& data)
 		}*/
 
 	case ct_help:
-		result << "commands:" << endl
+		result << "commands (prefixed with '@N' to select the bus N, default 0):" << endl
 		       << " get       - fetch ebus data             'get [class] cmd (sub)'" << endl
 		       << " set       - set ebus values             'set class cmd value'" << endl
 		       << " cyc       - fetch cycle data            'cyc [class] cmd (sub)'" << endl
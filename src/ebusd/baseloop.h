@@ -68,7 +68,7 @@ public:
 	result_t readConfigFiles(const string path, const string extension);
 
 	/**
-	 * @brief start baseloop instance.
+	 * @brief start baseloop instance (returns immediately if no valid device was given).
 	 */
 	void start();
 
@@ -93,17 +93,17 @@ private:
 	/** the @a MessageMap instance. */
 	MessageMap* m_messages;
 
-	/** the own master address for sending on the bus. */
-	unsigned char m_ownAddress;
+	/** the own master address for sending on each bus. */
+	vector<unsigned char> m_ownAddresses;
 
 	/** whether polling the messages is active. */
 	bool m_pollActive;
 
-	/** the @a Port instance. */
-	Port* m_port;
+	/** the @a Port instance of each bus. */
+	vector<Port*> m_ports;
 
-	/** the @a BusHandler instance. */
-	BusHandler* m_busHandler;
+	/** the @a BusHandler instance of each bus. */
+	vector<BusHandler*> m_busHandlers;
 
 	/** the @a Network instance. */
 	Network* m_network;
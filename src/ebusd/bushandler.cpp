@@ -61,8 +61,7 @@ const char* getStateCode(BusState state) {
 
 result_t PollRequest::prepare(unsigned char ownMasterAddress)
 {
-	istringstream input;
-	result_t result = m_message->prepareMaster(ownMasterAddress, m_master, input);
+	result_t result = m_message->prepareMaster(ownMasterAddress, m_master);
 	if (result == RESULT_OK)
 		L.log(bus, event, " poll msg: %s", m_master.getDataStr().c_str());
 	return result;
@@ -70,9 +69,16 @@ result_t PollRequest::prepare(unsigned char ownMasterAddress)
 
 void PollRequest::notify(result_t result)
 {
+	if (result == RESULT_OK && L.isLogged(bus, event) == false) {
+		// only store the typed values, the text is formatted when requested
+		result = m_message->decode(pt_slaveData, m_slave, false, UI_FIELD_SEPARATOR, m_busIndex); // decode data
+		if (result != RESULT_OK)
+			L.log(bus, error, "poll %s failed: %s", m_message->getName().c_str(), getResultCode(result));
+		return;
+	}
 	ostringstream output;
 	if (result == RESULT_OK) {
-		result = m_message->decode(pt_slaveData, m_slave, output); // decode data
+		result = m_message->decode(pt_slaveData, m_slave, output, false, UI_FIELD_SEPARATOR, m_busIndex); // decode data
 	}
 	if (result != RESULT_OK)
 		L.log(bus, error, "poll %s failed: %s", m_message->getName().c_str(), getResultCode(result));
@@ -83,8 +89,7 @@ void PollRequest::notify(result_t result)
 
 result_t ScanRequest::prepare(unsigned char ownMasterAddress, unsigned char dstAddress)
 {
-	istringstream input;
-	result_t result = m_message->prepareMaster(ownMasterAddress, m_master, input, UI_FIELD_SEPARATOR, dstAddress);
+	result_t result = m_message->prepareMaster(ownMasterAddress, m_master, StringView(), UI_FIELD_SEPARATOR, dstAddress);
 	if (result == RESULT_OK)
 		L.log(bus, event, " scan msg: %s", m_master.getDataStr().c_str());
 	return result;
@@ -94,7 +99,7 @@ void ScanRequest::notify(result_t result)
 {
 	if (result == RESULT_OK) {
 		m_scanResult << hex << setw(2) << setfill('0') << static_cast<unsigned>(m_master[1]) << UI_FIELD_SEPARATOR;
-		result = m_message->decode(pt_slaveData, m_slave, m_scanResult); // decode data
+		result = m_message->decode(pt_slaveData, m_slave, m_scanResult, false, UI_FIELD_SEPARATOR, m_busIndex); // decode data
 	}
 	if (result != RESULT_OK)
 		L.log(bus, error, "scan %x failed: %s", m_master[1], getResultCode(result));
@@ -172,29 +177,108 @@ result_t BusHandler::sendAndWait(SymbolString& master, SymbolString& slave)
 	return result;
 }
 
-void BusHandler::run()
+/**
+ * Wait with exponential backoff and reopen the closed device.
+ * @param port the @a Port to reopen.
+ * @param thread the calling @a Thread for stopping in time.
+ * @param reopenDelay the time [s] to wait, updated for the next attempt.
+ */
+static void reopenPort(Port* port, Thread* thread, unsigned int& reopenDelay)
 {
-	do {
-		if (m_port->isOpen() == true)
-			handleSymbol();
-		else {
-			// TODO: define max reopen
-			sleep(10);
-			result_t result = m_port->open();
+	// wait with exponential backoff, but stop in time
+	for (unsigned int waited = 0; waited < reopenDelay && thread->isRunning() == true; waited++)
+		sleep(1);
+	if (thread->isRunning() == false)
+		return;
+
+	result_t result = port->open();
+
+	if (result == RESULT_OK)
+		reopenDelay = REOPEN_MIN_DELAY;
+	else {
+		L.log(bus, error, "can't open %s: %s", port->getDeviceName().c_str(), getResultCode(result));
+		if (reopenDelay < REOPEN_MAX_DELAY)
+			reopenDelay *= 2;
+	}
+}
 
-			if (result != RESULT_OK)
-				L.log(bus, error, "can't open %s", A.getOptVal<const char*>("device"));
+void BusReader::run()
+{
+	unsigned char buffer[RECV_BUFFER_SIZE];
+	unsigned int reportedDropped = 0;
+	unsigned int reopenDelay = REOPEN_MIN_DELAY;
+
+	while (isRunning() == true) {
+		// this is the only thread opening and closing the device
+		if (m_port->isOpen() == false) {
+			reopenPort(m_port, this, reopenDelay);
+			continue;
+		}
+		ssize_t count = m_port->recv(READER_TIMEOUT, sizeof(buffer), buffer);
+		if (count == RESULT_ERR_TIMEOUT)
+			continue;
+		if (count < 0) {
+			usleep(READER_TIMEOUT);
+			continue;
+		}
 
+		ReceivedSymbol received;
+		clock_gettime(CLOCK_MONOTONIC, &received.time);
+		for (ssize_t pos = 0; pos < count; pos++) {
+			received.symbol = buffer[pos];
+			if (m_queue.push(received) == false)
+				m_droppedSymbols++;
+		}
+		if (m_droppedSymbols != reportedDropped) {
+			L.log(bus, error, "receive queue overflow, %d symbols dropped", m_droppedSymbols - reportedDropped);
+			reportedDropped = m_droppedSymbols;
 		}
+	}
+}
 
+ssize_t BusReader::recv(const long timeout, unsigned char& symbol, struct timespec* time)
+{
+	ReceivedSymbol received;
+	if (m_queue.pop(received, timeout) == false)
+		return RESULT_ERR_TIMEOUT;
+
+	symbol = received.symbol;
+	if (time != NULL)
+		*time = received.time;
+
+	return 1;
+}
+
+
+void BusHandler::run()
+{
+	if (m_reader != NULL)
+		m_reader->start("busreader");
+
+	unsigned int reopenDelay = REOPEN_MIN_DELAY;
+	unsigned long reportedDumpDropped = m_port->getDumpRawDropped();
+	do {
+		if (m_reader != NULL || m_port->isOpen() == true)
+			handleSymbol(); // the BusReader takes care of reopening the device
+		else
+			reopenPort(m_port, this, reopenDelay);
+
+		unsigned long dumpDropped = m_port->getDumpRawDropped();
+		if (dumpDropped != reportedDumpDropped) {
+			L.log(bus, error, "dump file not written fast enough, %lu bytes dropped", dumpDropped - reportedDumpDropped);
+			reportedDumpDropped = dumpDropped;
+		}
 	} while (isRunning() == true);
+
+	if (m_reader != NULL)
+		m_reader->join();
 }
 
 result_t BusHandler::handleSymbol()
 {
 	long timeout = SYN_TIMEOUT;
 	unsigned char sendSymbol = ESC;
-	bool sending = false;
+	bool sending = false, sent = false;
 
 	// check if another symbol has to be sent and determine timeout for receive
 	switch (m_state)
@@ -206,7 +290,8 @@ result_t BusHandler::handleSymbol()
 	case bs_ready:
 		if (m_request != NULL)
 			setState(bs_ready, RESULT_ERR_TIMEOUT); // just to be sure an old BusRequest is cleaned up
-		if (m_remainLockCount == 0) {
+		// a SYN left over in the queue may already be followed by another master's telegram
+		if (m_remainLockCount == 0 && m_staleSyn == false) {
 			m_request = m_requests.next(false);
 			if (m_request == NULL && m_pollInterval > 0) { // check for poll/scan
 				time_t now;
@@ -215,7 +300,7 @@ result_t BusHandler::handleSymbol()
 					Message* message = m_messages->getNextPoll();
 					if (message != NULL) {
 						m_lastPoll = now;
-						PollRequest* request = new PollRequest(m_response, message);
+						PollRequest* request = new PollRequest(m_response, message, m_index);
 						result_t ret = request->prepare(m_ownMasterAddress);
 						if (ret != RESULT_OK) {
 							L.log(bus, error, " prepare poll message: %s", getResultCode(ret));
@@ -246,6 +331,18 @@ result_t BusHandler::handleSymbol()
 		if (m_request != NULL) {
 			sendSymbol = m_request->m_master[m_nextSendPos];
 			sending = true;
+			if (m_burstSend == true && m_nextSendPos >= m_burstEndPos) {
+				// send all remaining symbols at once and verify the echo afterwards
+				size_t count = m_request->m_master.size() - m_nextSendPos;
+				if (m_port->send(m_request->m_master.data() + m_nextSendPos, count) == (ssize_t)count)
+					m_burstEndPos = (unsigned char)m_request->m_master.size();
+				else {
+					sending = false;
+					timeout = 0;
+					setState(bs_skip, RESULT_ERR_SEND);
+				}
+			}
+			sent = m_nextSendPos < m_burstEndPos;
 		}
 		break;
 
@@ -277,7 +374,9 @@ result_t BusHandler::handleSymbol()
 	}
 
 	// send symbol if necessary
-	if (sending == true) {
+	if (sending == true && sent == true)
+		timeout = SEND_TIMEOUT;
+	else if (sending == true) {
 		if (m_port->send(&sendSymbol, 1) == 1)
 			if (m_state == bs_ready)
 				timeout = m_busAcquireTimeout;
@@ -292,7 +391,23 @@ result_t BusHandler::handleSymbol()
 
 	// receive next symbol (optionally check reception of sent symbol)
 	unsigned char recvSymbol;
-	ssize_t count = m_port->recv(timeout, 1, &recvSymbol);
+	ssize_t count;
+	if (m_reader != NULL) {
+		// never wait endlessly in order to stop in time
+		struct timespec recvTime;
+		count = m_reader->recv(timeout == 0 ? READER_TIMEOUT : timeout, recvSymbol, &recvTime);
+		if (count == RESULT_ERR_TIMEOUT && timeout == 0)
+			return RESULT_ERR_TIMEOUT;
+		if (count > 0 && recvSymbol == SYN) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			long long age = (long long)(now.tv_sec - recvTime.tv_sec) * 1000000
+				+ (now.tv_nsec - recvTime.tv_nsec) / 1000;
+			m_staleSyn = age > SYN_MAX_AGE;
+		}
+	}
+	else
+		count = m_port->recv(timeout, 1, &recvSymbol);
 
 	if (count < 0) // count < 0 is a RESULT_ERR_ code
 		return setState(bs_skip, count); // TODO keep "no signal" within auto-syn state
@@ -474,6 +589,9 @@ result_t BusHandler::handleSymbol()
 				}
 				return RESULT_OK;
 			}
+			if (sent == true)
+				L.log(bus, error, " burst echo mismatch at %d: sent %2.2x, received %2.2x",
+					m_nextSendPos, sendSymbol, recvSymbol);
 		}
 		return setState(bs_skip, RESULT_ERR_INVALID_ARG);
 
@@ -563,7 +681,7 @@ result_t BusHandler::setState(BusState state, result_t result, bool firstRepetit
 			m_request = NULL;
 		} else if (state == bs_sendSyn || (result != RESULT_OK && firstRepetition == false)) {
 			L.log(bus, debug, "notify request: %s", getResultCode(result));
-			m_request->m_slave = SymbolString(m_response, false, false);
+			m_request->m_slave.swap(m_response); // m_response is not needed anymore and cleared on next state change
 			m_request->notify(result);
 			if (m_request->m_deleteOnFinish == true) {
 				if (result == RESULT_OK && typeid(*m_request) == typeid(ScanRequest)) {
@@ -586,6 +704,7 @@ result_t BusHandler::setState(BusState state, result_t result, bool firstRepetit
 	else if (m_request != NULL || state == bs_sendCmd || state==bs_sendResAck || state==bs_sendSyn)
 		L.log(bus, debug, " switching from %s to %s", getStateCode(m_state), getStateCode(state));
 	m_state = state;
+	m_burstEndPos = 0;
 
 	if (state == bs_ready || state == bs_skip) {
 		m_command.clear();
@@ -603,14 +722,19 @@ void BusHandler::receiveCompleted()
 	unsigned char dstAddress = m_command[1];
 	bool master = isMaster(dstAddress);
 
+	char commandStr[2*MAX_SYMBOLS+1], responseStr[2*MAX_SYMBOLS+1];
+	m_command.getDataStr(commandStr);
+	responseStr[0] = 0;
+
 	m_seenAddresses[m_command[0]] = true;
 	if (dstAddress == BROADCAST)
-		L.log(bus, trace, "received BC %s", m_command.getDataStr().c_str());
+		L.log(bus, trace, "bus %lu: received BC %s", (unsigned long)m_index, commandStr);
 	else if (master == true) {
-		L.log(bus, trace, "received MM %s", m_command.getDataStr().c_str());
+		L.log(bus, trace, "bus %lu: received MM %s", (unsigned long)m_index, commandStr);
 		m_seenAddresses[dstAddress] = true;
 	} else {
-		L.log(bus, trace, "received MS %s / %s", m_command.getDataStr().c_str(), m_response.getDataStr().c_str());
+		m_response.getDataStr(responseStr);
+		L.log(bus, trace, "bus %lu: received MS %s / %s", (unsigned long)m_index, commandStr, responseStr);
 		m_seenAddresses[dstAddress] = true;
 	}
 
@@ -619,14 +743,26 @@ void BusHandler::receiveCompleted()
 		string clazz = message->getClass();
 		string name = message->getName();
 		ostringstream output;
-		result_t result = message->decode(pt_masterData, m_command, output);
-		if (result == RESULT_OK && dstAddress != BROADCAST && master == false)
-			result = message->decode(pt_slaveData, m_response, output, output.str().empty() == false);
-		if (result != RESULT_OK)
-			L.log(bus, error, "unable to parse %s %s from %s / %s: %s", clazz.c_str(), name.c_str(), m_command.getDataStr().c_str(), m_response.getDataStr().c_str(), getResultCode(result));
+		result_t result;
+		bool logged = L.isLogged(bus, event);
+		if (logged == false) {
+			// only store the typed values, the text is formatted when requested
+			result = message->decode(pt_masterData, m_command, false, UI_FIELD_SEPARATOR, m_index);
+			if (result == RESULT_OK && dstAddress != BROADCAST && master == false)
+				result = message->decode(pt_slaveData, m_response, message->hasLastValues(m_index),
+						UI_FIELD_SEPARATOR, m_index);
+		}
 		else {
+			result = message->decode(pt_masterData, m_command, output, false, UI_FIELD_SEPARATOR, m_index);
+			if (result == RESULT_OK && dstAddress != BROADCAST && master == false)
+				result = message->decode(pt_slaveData, m_response, output, output.str().empty() == false,
+						UI_FIELD_SEPARATOR, m_index);
+		}
+		if (result != RESULT_OK)
+			L.log(bus, error, "bus %lu: unable to parse %s %s from %s / %s: %s", (unsigned long)m_index, clazz.c_str(), name.c_str(), commandStr, responseStr, getResultCode(result));
+		else if (logged == true) {
 			string data = output.str();
-			L.log(bus, event, "%s %s: %s", clazz.c_str(), name.c_str(), data.c_str());
+			L.log(bus, event, "bus %lu: %s %s: %s", (unsigned long)m_index, clazz.c_str(), name.c_str(), data.c_str());
 		}
 	}
 }
@@ -656,7 +792,7 @@ result_t BusHandler::startScan(bool full)
 				continue;
 		}
 
-		ScanRequest* request = new ScanRequest(m_response, scanMessage);
+		ScanRequest* request = new ScanRequest(m_response, scanMessage, m_index);
 		result_t result = request->prepare(m_ownMasterAddress, slave);
 		if (result != RESULT_OK) {
 			delete request;
@@ -26,6 +26,7 @@
 #include "result.h"
 #include "port.h"
 #include "wqueue.h"
+#include "rqueue.h"
 #include "thread.h"
 #include <string>
 #include <vector>
@@ -43,6 +44,16 @@ using namespace std;
 #define SYMBOL_DURATION 4700
 /** the maximum allowed time [us] for retrieving back a sent symbol (2x symbol duration). */
 #define SEND_TIMEOUT (2*SYMBOL_DURATION)
+/** the maximum age [us] of a SYN from the @a BusReader queue for starting arbitration (one symbol). */
+#define SYN_MAX_AGE 4200
+/** the time [us] after which the @a BusReader checks whether it shall stop. */
+#define READER_TIMEOUT 100000
+/** the initial time [s] to wait before reopening a closed device (doubled after each failure). */
+#define REOPEN_MIN_DELAY 1
+/** the maximum time [s] to wait before reopening a closed device. */
+#define REOPEN_MAX_DELAY 64
+/** the capacity of the @a BusReader queue (power of two, about 2 seconds at 2400Bd). */
+#define READER_QUEUE_SIZE 512
 
 /** the possible bus states. */
 enum BusState {
@@ -119,9 +130,10 @@ public:
 	 * @brief Constructor.
 	 * @param slave the slave data @a SymbolString received.
 	 * @param message the associated @a Message.
+	 * @param busIndex the index of the bus the request is sent on.
 	 */
-	PollRequest(SymbolString& slave, Message* message)
-		: BusRequest(m_master, slave, true), m_message(message) {}
+	PollRequest(SymbolString& slave, Message* message, const size_t busIndex)
+		: BusRequest(m_master, slave, true), m_message(message), m_busIndex(busIndex) {}
 
 	/**
 	 * @brief Destructor.
@@ -146,6 +158,9 @@ private:
 	/** the associated @a Message. */
 	Message* m_message;
 
+	/** the index of the bus the request is sent on. */
+	const size_t m_busIndex;
+
 };
 
 
@@ -161,9 +176,10 @@ public:
 	 * @brief Constructor.
 	 * @param slave the slave data @a SymbolString received.
 	 * @param message the associated @a Message.
+	 * @param busIndex the index of the bus the request is sent on.
 	 */
-	ScanRequest(SymbolString& slave, Message* message)
-		: BusRequest(m_master, slave, true), m_message(message) {}
+	ScanRequest(SymbolString& slave, Message* message, const size_t busIndex)
+		: BusRequest(m_master, slave, true), m_message(message), m_busIndex(busIndex) {}
 
 	/**
 	 * @brief Destructor.
@@ -189,6 +205,9 @@ private:
 	/** the associated @a Message. */
 	Message* m_message;
 
+	/** the index of the bus the request is sent on. */
+	const size_t m_busIndex;
+
 	/** the formatted scan result. */
 	ostringstream m_scanResult;
 
@@ -242,6 +261,69 @@ private:
 };
 
 
+/**
+ * @brief A symbol received by the @a BusReader.
+ */
+struct ReceivedSymbol
+{
+	/** the received symbol. */
+	unsigned char symbol;
+
+	/** the monotonic time of reception. */
+	struct timespec time;
+};
+
+
+/**
+ * @brief Reads from the bus in a dedicated thread, so that reception does not
+ * depend on the @a BusHandler being busy with decoding and logging.
+ * This thread is also the only one opening, reopening, and closing the device,
+ * while the @a BusHandler only sends to it.
+ */
+class BusReader : public Thread
+{
+public:
+
+	/**
+	 * @brief Construct a new instance.
+	 * @param port the @a Port instance for accessing the bus.
+	 */
+	BusReader(Port* port) : m_port(port), m_droppedSymbols(0) {}
+
+	/**
+	 * @brief Main thread entry.
+	 */
+	virtual void run();
+
+	/**
+	 * @brief Fetch the next received symbol (may only be called from a single thread).
+	 * @param timeout max time out for a new symbol [usec], or 0 for infinite.
+	 * @param symbol the variable in which to store the received symbol.
+	 * @param time optional variable in which to store the monotonic time of reception.
+	 * @return 1 if a symbol was fetched, or RESULT_ERR_TIMEOUT.
+	 */
+	ssize_t recv(const long timeout, unsigned char& symbol, struct timespec* time=NULL);
+
+	/**
+	 * @brief Get the number of symbols dropped due to a full queue.
+	 * @return the number of symbols dropped due to a full queue.
+	 */
+	unsigned int getDroppedSymbols() { return m_droppedSymbols; }
+
+private:
+
+	/** the @a Port instance for accessing the bus. */
+	Port* m_port;
+
+	/** the queue of received symbols. */
+	RQueue<ReceivedSymbol, READER_QUEUE_SIZE> m_queue;
+
+	/** the number of symbols dropped due to a full queue. */
+	unsigned int m_droppedSymbols;
+
+};
+
+
 /**
  * @brief Handles input from and output to the bus with respect to the ebus protocol.
  */
@@ -252,6 +334,7 @@ public:
 	/**
 	 * @brief Construct a new instance.
 	 * @param port the @a Port instance for accessing the bus.
+	 * @param index the index of the bus (0 for the first one).
 	 * @param messages the @a MessageMap instance with all known @a Message instances.
 	 * @param ownAddress the own master address.
 	 * @param answer whether to answer queries for the own master/slave address.
@@ -261,19 +344,22 @@ public:
 	 * @param busAcquireTimeout the maximum time in microseconds for bus acquisition.
 	 * @param lockCount the number of AUTO-SYN symbols before sending is allowed after lost arbitration.
 	 * @param pollInterval the interval in seconds in which poll messages are cycled, or 0 if disabled.
+	 * @param readThread whether to read from the bus in a dedicated @a BusReader thread.
+	 * @param burstSend whether to send the master data after arbitration in a single write.
 	 */
-	BusHandler(Port* port, MessageMap* messages,
+	BusHandler(Port* port, const size_t index, MessageMap* messages,
 			const unsigned char ownAddress, const bool answer,
 			const unsigned int busLostRetries, const unsigned int failedSendRetries,
 			const unsigned int busAcquireTimeout, const unsigned int slaveRecvTimeout,
-			const unsigned int lockCount, const unsigned int pollInterval)
-		: m_port(port), m_messages(messages),
+			const unsigned int lockCount, const unsigned int pollInterval,
+			const bool readThread=false, const bool burstSend=false)
+		: m_port(port), m_index(index), m_reader(readThread == true ? new BusReader(port) : NULL), m_messages(messages),
 		  m_ownMasterAddress(ownAddress), m_ownSlaveAddress((ownAddress+5)&0xff), m_answer(answer),
 		  m_busLostRetries(busLostRetries), m_failedSendRetries(failedSendRetries),
 		  m_busAcquireTimeout(busAcquireTimeout), m_slaveRecvTimeout(slaveRecvTimeout),
-		  m_lockCount(lockCount), m_remainLockCount(lockCount),
-		  m_pollInterval(pollInterval), m_lastPoll(0),
-		  m_request(NULL), m_nextSendPos(0),
+		  m_lockCount(lockCount), m_remainLockCount(lockCount), m_staleSyn(false),
+		  m_pollInterval(pollInterval), m_burstSend(burstSend), m_lastPoll(0),
+		  m_request(NULL), m_nextSendPos(0), m_burstEndPos(0),
 		  m_state(bs_skip), m_repeat(false),
 		  m_commandCrcValid(false), m_responseCrcValid(false),
 		  m_scanMessage(NULL) {
@@ -286,6 +372,8 @@ public:
 	virtual ~BusHandler() {
 		if (m_scanMessage != NULL)
 			delete m_scanMessage;
+		if (m_reader != NULL)
+			delete m_reader;
 	}
 
 	/**
@@ -344,6 +432,12 @@ private:
 	/** the @a Port instance for accessing the bus. */
 	Port* m_port;
 
+	/** the index of the bus for keeping the last decoded values of each @a Message apart. */
+	const size_t m_index;
+
+	/** the @a BusReader reading from the bus in a dedicated thread, or NULL. */
+	BusReader* m_reader;
+
 	/** the @a MessageMap instance with all known @a Message instances. */
 	MessageMap* m_messages;
 
@@ -374,9 +468,15 @@ private:
 	/** the remaining number of AUTO-SYN symbols before sending is allowed again. */
 	unsigned int m_remainLockCount;
 
+	/** whether the last SYN was taken from the @a BusReader queue too late for arbitration. */
+	bool m_staleSyn;
+
 	/** the interval in seconds in which poll messages are cycled, or 0 if disabled. */
 	const unsigned int m_pollInterval;
 
+	/** whether to send the master data after arbitration in a single write. */
+	const bool m_burstSend;
+
 	/** the time of the last poll, or 0 for never. */
 	time_t m_lastPoll;
 
@@ -390,6 +490,10 @@ private:
 	 * (only relevant if m_request is set and state is bs_command or bs_response). */
 	unsigned char m_nextSendPos;
 
+	/** the offset after the last symbol already sent in a burst, whose echo is
+	 * verified symbol by symbol (only relevant in state bs_sendCmd). */
+	unsigned char m_burstEndPos;
+
 	/** the current @a BusState. */
 	BusState m_state;
 
@@ -50,10 +50,24 @@ void define_args()
 		    "\tanswers to requests from other devices");
 
 	A.addOption("device", "d", OptVal("/dev/ttyUSB0"), dt_string, ot_mandatory,
-		    "\tebus device (serial or network) (/dev/ttyUSB0)");
+		    "\tebus device (serial, network or replay) (/dev/ttyUSB0)\n"
+		    "\t\t\tseveral buses separated by ',', each optionally with own\n"
+		    "\t\t\taddress 'device@address' and selected by '@N cmd'");
 
 	A.addOption("nodevicecheck", "n", OptVal(false), dt_bool, ot_none,
-		    "disable valid ebus device test\n");
+		    "disable valid ebus device test");
+
+	A.addOption("readthread", "", OptVal(false), dt_bool, ot_none,
+		    "read from ebus device in a dedicated thread");
+
+	A.addOption("burstsend", "", OptVal(false), dt_bool, ot_none,
+		    "send master data in a single write after arbitration");
+
+	A.addOption("replayspeed", "", OptVal(1.0f), dt_float, ot_mandatory,
+		    "speed factor for device 'replay:dumpfile', 0 for max (1)");
+
+	A.addOption("replayecho", "", OptVal(false), dt_bool, ot_none,
+		    "echo sent bytes for device 'replay:dumpfile'\n");
 
 	A.addOption("sendretries", "s", OptVal(2), dt_int, ot_mandatory,
 		    "number retries send ebus command (2)");
@@ -104,7 +118,10 @@ void define_args()
 		    "\tdump file name (/tmp/ebus_dump.bin)");
 
 	A.addOption("dumpsize", "", OptVal(100), dt_long, ot_mandatory,
-		    "\tmax size for dump file in 'kB' (100)\n");
+		    "\tmax size for dump file in 'kB' (100)");
+
+	A.addOption("dumpcapture", "", OptVal(false), dt_bool, ot_none,
+		    "dump in capture format with timing and sent bytes\n");
 }
 
 void shutdown()
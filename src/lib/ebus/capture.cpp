@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "capture.h"
+#include <cstring>
+#include <time.h>
+#include <sys/time.h>
+
+using namespace std;
+
+/**
+ * @brief Write a 64 bit value in little endian byte order.
+ * @param out the buffer to write to.
+ * @param value the value to write.
+ */
+static void putUint64(unsigned char* out, unsigned long long value)
+{
+	for (int i = 0; i < 8; i++) {
+		out[i] = (unsigned char)(value & 0xff);
+		value >>= 8;
+	}
+}
+
+/**
+ * @brief Read a 64 bit value in little endian byte order.
+ * @param in the buffer to read from.
+ * @return the value read.
+ */
+static unsigned long long getUint64(const unsigned char* in)
+{
+	unsigned long long value = 0;
+	for (int i = 7; i >= 0; i--)
+		value = (value << 8) | in[i];
+	return value;
+}
+
+/**
+ * @brief Return the number of bytes needed for encoding a value as varint.
+ * @param value the value to encode.
+ * @return the number of bytes needed.
+ */
+static size_t varintLength(unsigned long long value)
+{
+	size_t length = 1;
+	while (value >= 0x80) {
+		value >>= 7;
+		length++;
+	}
+	return length;
+}
+
+/**
+ * @brief Write a value as varint (7 bits per byte, least significant first).
+ * @param out the buffer to write to.
+ * @param value the value to write.
+ * @return the number of bytes written.
+ */
+static size_t putVarint(unsigned char* out, unsigned long long value)
+{
+	size_t length = 0;
+	while (value >= 0x80) {
+		out[length++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	out[length++] = (unsigned char)value;
+	return length;
+}
+
+/**
+ * @brief Read a varint value.
+ * @param in the buffer to read from.
+ * @param length the number of bytes available in @a in.
+ * @param pos the position to read from, updated to the position after the value.
+ * @param value the variable in which to store the value.
+ * @return true on success, false if the value is incomplete.
+ */
+static bool getVarint(const unsigned char* in, const size_t length, size_t& pos, unsigned long long& value)
+{
+	value = 0;
+	for (int shift = 0; pos < length && shift < 64; shift += 7) {
+		unsigned char byte = in[pos++];
+		value |= (unsigned long long)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+unsigned long long getMonotonicTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+size_t CaptureEncoder::begin(unsigned char* out)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	memcpy(out, CAPTURE_MAGIC, 7);
+	out[7] = CAPTURE_VERSION;
+	putUint64(out + 8, (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec);
+	putUint64(out + 16, getMonotonicTime());
+
+	m_offset = CAPTURE_HEADER_SIZE;
+	m_blockStarted = false;
+	return CAPTURE_HEADER_SIZE;
+}
+
+size_t CaptureEncoder::encode(unsigned long long time, const bool sent, const unsigned char* data, size_t count, unsigned char* out)
+{
+	if (count > CAPTURE_MAX_RECORD)
+		count = CAPTURE_MAX_RECORD;
+
+	size_t length = 0;
+	while (true) {
+		if (m_offset % CAPTURE_BLOCK_SIZE == 0)
+			m_blockStarted = false;
+
+		if (m_blockStarted == false) {
+			putUint64(out + length, time);
+			length += CAPTURE_BLOCK_HEADER_SIZE;
+			m_offset += CAPTURE_BLOCK_HEADER_SIZE;
+			m_lastTime = time;
+			m_blockStarted = true;
+		}
+		if (time < m_lastTime)
+			time = m_lastTime; // stamped in different threads
+
+		unsigned long long header = ((time - m_lastTime) << 2) | (sent == true ? CAPTURE_SENT : CAPTURE_RECEIVED);
+		size_t needed = varintLength(header) + varintLength(count) + count;
+		size_t remain = CAPTURE_BLOCK_SIZE - m_offset % CAPTURE_BLOCK_SIZE;
+		if (needed <= remain) {
+			length += putVarint(out + length, header);
+			length += putVarint(out + length, count);
+			memcpy(out + length, data, count);
+			length += count;
+			m_offset += needed;
+			m_lastTime = time;
+			return length;
+		}
+
+		// record does not fit into the current block
+		memset(out + length, 0, remain);
+		length += remain;
+		m_offset += remain;
+	}
+}
+
+
+result_t CaptureReader::open(const string& fileName)
+{
+	m_mapped = NULL;
+	m_stream.open(fileName.c_str(), ios::in | ios::binary);
+	if (m_stream.is_open() == false)
+		return RESULT_ERR_NOTFOUND;
+
+	result_t result = readHeader();
+	if (result != RESULT_OK)
+		m_stream.close();
+	return result;
+}
+
+result_t CaptureReader::open(const unsigned char* data, const size_t size)
+{
+	m_mapped = data;
+	m_mappedSize = size;
+
+	result_t result = readHeader();
+	if (result != RESULT_OK)
+		m_mapped = NULL;
+	return result;
+}
+
+result_t CaptureReader::readHeader()
+{
+	size_t length = CAPTURE_HEADER_SIZE;
+	const unsigned char* header = readAt(0, length);
+	if (length != CAPTURE_HEADER_SIZE
+	|| memcmp(header, CAPTURE_MAGIC, 7) != 0 || header[7] != CAPTURE_VERSION)
+		return RESULT_ERR_INVALID_ARG;
+
+	m_wallTime = getUint64(header + 8);
+	m_startTime = getUint64(header + 16);
+	m_block = 0;
+	m_blockLength = 0;
+	return RESULT_OK;
+}
+
+const unsigned char* CaptureReader::readAt(const unsigned long long offset, size_t& length)
+{
+	if (m_mapped != NULL) {
+		if (offset >= m_mappedSize)
+			length = 0;
+		else if (offset + length > m_mappedSize)
+			length = (size_t)(m_mappedSize - offset);
+		return m_mapped + offset;
+	}
+
+	m_stream.clear();
+	m_stream.seekg((streamoff)offset);
+	m_stream.read((char*)m_buffer, length);
+	length = m_stream.gcount();
+	return m_buffer;
+}
+
+result_t CaptureReader::loadBlock(const unsigned long block)
+{
+	size_t length = CAPTURE_BLOCK_SIZE;
+	m_data = readAt((unsigned long long)block * CAPTURE_BLOCK_SIZE, length);
+	m_pos = block == 0 ? CAPTURE_HEADER_SIZE : 0;
+	if (length < m_pos + CAPTURE_BLOCK_HEADER_SIZE)
+		return RESULT_ERR_EOF;
+
+	m_block = block;
+	m_blockLength = length;
+	m_time = getUint64(m_data + m_pos);
+	m_pos += CAPTURE_BLOCK_HEADER_SIZE;
+	return RESULT_OK;
+}
+
+result_t CaptureReader::next(unsigned long long& time, bool& sent, unsigned char* data, size_t& count)
+{
+	while (true) {
+		if (m_blockLength == 0) {
+			result_t result = loadBlock(m_block);
+			if (result != RESULT_OK)
+				return result;
+		}
+
+		if (m_pos < m_blockLength && m_data[m_pos] != 0) {
+			size_t pos = m_pos;
+			unsigned long long header, length;
+			if (getVarint(m_data, m_blockLength, pos, header) == true
+			&& getVarint(m_data, m_blockLength, pos, length) == true
+			&& length <= CAPTURE_MAX_RECORD && pos + length <= m_blockLength) {
+				m_time += header >> 2;
+				time = m_time;
+				sent = (header & 0x03) == CAPTURE_SENT;
+				count = (size_t)length;
+				memcpy(data, m_data + pos, count);
+				m_pos = pos + count;
+				return RESULT_OK;
+			}
+			if (m_blockLength < CAPTURE_BLOCK_SIZE)
+				return RESULT_ERR_EOF; // incomplete record at end of file
+			// invalid record: continue with next block
+		}
+		else if (m_blockLength < CAPTURE_BLOCK_SIZE)
+			return RESULT_ERR_EOF;
+
+		// unused remainder of block
+		m_block++;
+		m_blockLength = 0;
+	}
+}
+
+result_t CaptureReader::seek(const unsigned long long time)
+{
+	unsigned long long size;
+	if (m_mapped != NULL)
+		size = m_mappedSize;
+	else {
+		m_stream.clear();
+		m_stream.seekg(0, ios::end);
+		size = m_stream.tellg();
+	}
+	unsigned long blocks = (unsigned long)((size + CAPTURE_BLOCK_SIZE - 1) / CAPTURE_BLOCK_SIZE);
+
+	// binary search for the last block starting at or before the time
+	unsigned long low = 0, high = blocks;
+	while (high - low > 1) {
+		unsigned long mid = (low + high) / 2;
+		size_t length = CAPTURE_BLOCK_HEADER_SIZE;
+		const unsigned char* header = readAt((unsigned long long)mid * CAPTURE_BLOCK_SIZE, length);
+		if (length == CAPTURE_BLOCK_HEADER_SIZE && getUint64(header) <= time)
+			low = mid;
+		else
+			high = mid;
+	}
+
+	m_block = low;
+	m_blockLength = 0;
+	return RESULT_OK;
+}
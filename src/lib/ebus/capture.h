@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef LIBEBUS_CAPTURE_H_
+#define LIBEBUS_CAPTURE_H_
+
+#include "result.h"
+#include <string>
+#include <fstream>
+
+using namespace std;
+
+/** \file capture.h
+ * The capture file format for raw bus symbols with timing information:
+ * - the file header of @a CAPTURE_HEADER_SIZE bytes consists of @a CAPTURE_MAGIC,
+ *   the @a CAPTURE_VERSION byte, the wall clock time and the monotonic time of
+ *   creation (both in microseconds as 64 bit little endian).
+ * - the file is divided into blocks of @a CAPTURE_BLOCK_SIZE bytes (the first one
+ *   starting with the file header). Each block starts with the monotonic time in
+ *   microseconds (64 bit little endian), so that a time can be found by a binary
+ *   search over the blocks.
+ * - the remainder of a block is filled with records, each consisting of a varint
+ *   header (time delta in microseconds to the previous record or the block start
+ *   shifted left by 2, ORed with @a CAPTURE_RECEIVED or @a CAPTURE_SENT), the varint
+ *   number of symbols, and the symbols themselves.
+ * - records never span a block boundary. A zero byte instead of a record header
+ *   marks the remainder of a block as unused.
+ */
+
+/** the magic bytes at the start of a capture file. */
+#define CAPTURE_MAGIC "eBUScap"
+
+/** the capture file format version. */
+#define CAPTURE_VERSION 1
+
+/** the size of the capture file header. */
+#define CAPTURE_HEADER_SIZE 24
+
+/** the size of a block within a capture file. */
+#define CAPTURE_BLOCK_SIZE 4096
+
+/** the size of the header at the start of each block. */
+#define CAPTURE_BLOCK_HEADER_SIZE 8
+
+/** the maximum number of symbols in a single record. */
+#define CAPTURE_MAX_RECORD 256
+
+/** the maximum number of bytes produced by @a CaptureEncoder::encode() for a single record. */
+#define CAPTURE_MAX_ENCODED (CAPTURE_BLOCK_SIZE+CAPTURE_BLOCK_HEADER_SIZE+CAPTURE_MAX_RECORD+2*10)
+
+/** the record type for received symbols. */
+#define CAPTURE_RECEIVED 1
+
+/** the record type for sent symbols. */
+#define CAPTURE_SENT 2
+
+
+/**
+ * @brief Return the current monotonic time in microseconds.
+ * @return the current monotonic time in microseconds.
+ */
+unsigned long long getMonotonicTime();
+
+
+/**
+ * @brief Encodes records of the capture file format.
+ */
+class CaptureEncoder
+{
+
+public:
+	/**
+	 * @brief constructs a new instance.
+	 */
+	CaptureEncoder() : m_offset(0), m_blockStarted(false), m_lastTime(0) {}
+
+	/**
+	 * @brief start a new capture file.
+	 * @param out the buffer to write the file header to (at least @a CAPTURE_HEADER_SIZE bytes).
+	 * @return the number of bytes written to @a out.
+	 */
+	size_t begin(unsigned char* out);
+
+	/**
+	 * @brief encode a single record.
+	 * @param time the monotonic time of the record in microseconds.
+	 * @param sent true for sent symbols, false for received symbols.
+	 * @param data the symbols.
+	 * @param count the number of symbols (at most @a CAPTURE_MAX_RECORD).
+	 * @param out the buffer to write the record (including necessary padding and
+	 * block header) to (at least @a CAPTURE_MAX_ENCODED bytes).
+	 * @return the number of bytes written to @a out.
+	 */
+	size_t encode(unsigned long long time, const bool sent, const unsigned char* data, size_t count, unsigned char* out);
+
+private:
+	/** the offset in the capture file. */
+	unsigned long long m_offset;
+
+	/** whether the header of the current block was already written. */
+	bool m_blockStarted;
+
+	/** the time of the last record or block start. */
+	unsigned long long m_lastTime;
+
+};
+
+
+/**
+ * @brief Reads records from a capture file.
+ */
+class CaptureReader
+{
+
+public:
+	/**
+	 * @brief constructs a new instance.
+	 */
+	CaptureReader() : m_mapped(NULL), m_mappedSize(0), m_wallTime(0), m_startTime(0),
+		m_block(0), m_data(NULL), m_blockLength(0), m_pos(0), m_time(0) {}
+
+	/**
+	 * @brief open a capture file.
+	 * @param fileName the name of the file to open.
+	 * @return RESULT_OK on success, RESULT_ERR_NOTFOUND if the file could not be opened,
+	 * or RESULT_ERR_INVALID_ARG if it is not a capture file.
+	 */
+	result_t open(const string& fileName);
+
+	/**
+	 * @brief open a capture file already available in memory (e.g. mapped).
+	 * @param data the file content (has to stay valid until @a close() is called).
+	 * @param size the size of @a data.
+	 * @return RESULT_OK on success, or RESULT_ERR_INVALID_ARG if it is not a capture file.
+	 */
+	result_t open(const unsigned char* data, const size_t size);
+
+	/**
+	 * @brief close the file.
+	 */
+	void close() { m_stream.close(); m_mapped = NULL; }
+
+	/**
+	 * @brief read the next record.
+	 * @param time the variable in which to store the monotonic time of the record in microseconds.
+	 * @param sent the variable in which to store whether the symbols were sent.
+	 * @param data the buffer to store the symbols in (at least @a CAPTURE_MAX_RECORD bytes).
+	 * @param count the variable in which to store the number of symbols.
+	 * @return RESULT_OK on success, or RESULT_ERR_EOF at the end of the file.
+	 */
+	result_t next(unsigned long long& time, bool& sent, unsigned char* data, size_t& count);
+
+	/**
+	 * @brief position at the start of the last block beginning before the specified time.
+	 * @param time the monotonic time in microseconds to seek to.
+	 * @return RESULT_OK on success, or an error code.
+	 */
+	result_t seek(const unsigned long long time);
+
+	/**
+	 * @brief get the wall clock time the capture file was created.
+	 * @return the wall clock time in microseconds since the epoch.
+	 */
+	unsigned long long getWallTime() { return m_wallTime; }
+
+	/**
+	 * @brief get the monotonic time the capture file was created.
+	 * @return the monotonic time in microseconds.
+	 */
+	unsigned long long getStartTime() { return m_startTime; }
+
+private:
+	/**
+	 * @brief check the file header and prepare for reading the first block.
+	 * @return RESULT_OK on success, or RESULT_ERR_INVALID_ARG if it is not a capture file.
+	 */
+	result_t readHeader();
+
+	/**
+	 * @brief get the data at the specified offset of the file.
+	 * @param offset the offset in the file.
+	 * @param length the maximum number of bytes to get (at most @a CAPTURE_BLOCK_SIZE),
+	 * updated to the number of bytes available.
+	 * @return the pointer to the data.
+	 */
+	const unsigned char* readAt(const unsigned long long offset, size_t& length);
+
+	/**
+	 * @brief load the specified block.
+	 * @param block the index of the block to load.
+	 * @return RESULT_OK on success, or RESULT_ERR_EOF if the block is not available.
+	 */
+	result_t loadBlock(const unsigned long block);
+
+	/** the @a ifstream to read from (if not in memory). */
+	ifstream m_stream;
+
+	/** the file content in memory, or NULL. */
+	const unsigned char* m_mapped;
+
+	/** the size of @a m_mapped. */
+	size_t m_mappedSize;
+
+	/** the wall clock time the capture file was created. */
+	unsigned long long m_wallTime;
+
+	/** the monotonic time the capture file was created. */
+	unsigned long long m_startTime;
+
+	/** the index of the current block. */
+	unsigned long m_block;
+
+	/** the buffer for reading from @a m_stream. */
+	unsigned char m_buffer[CAPTURE_BLOCK_SIZE];
+
+	/** the current block. */
+	const unsigned char* m_data;
+
+	/** the number of bytes available in @a m_data. */
+	size_t m_blockLength;
+
+	/** the position of the next record in @a m_data. */
+	size_t m_pos;
+
+	/** the time of the last record or block start. */
+	unsigned long long m_time;
+
+};
+
+#endif // LIBEBUS_CAPTURE_H_
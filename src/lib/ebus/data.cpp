@@ -105,9 +105,159 @@ unsigned int parseInt(const char* str, int base, const unsigned int minValue, co
 	return ret;
 }
 
-void printErrorPos(vector<string>::iterator begin, const vector<string>::iterator end, vector<string>::iterator pos)
+/**
+ * @brief Write the decimal digits of an unsigned value.
+ * @param value the value to write.
+ * @param minDigits the minimum number of digits (filled up with leading zeros).
+ * @param buffer the buffer to write the digits to.
+ * @return the pointer behind the last written digit.
+ */
+static char* writeDigits(unsigned long long value, const int minDigits, char* buffer)
+{
+	char digits[20];
+	int count = 0;
+	do {
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0 || count < minDigits);
+	while (count > 0)
+		*buffer++ = digits[--count];
+	return buffer;
+}
+
+size_t formatFixed(const long long value, const unsigned int divisor, const int precision, char* buffer)
+{
+	char* pos = buffer;
+	unsigned long long magnitude = (unsigned long long)value;
+	if (value < 0) {
+		*pos++ = '-';
+		magnitude = 0 - magnitude;
+	}
+	if (divisor <= 1) {
+		pos = writeDigits(magnitude, 1, pos);
+		*pos = 0;
+		return pos - buffer;
+	}
+
+	int digits = precision < 0 ? 0 : precision > 9 ? 9 : precision;
+	unsigned long long scale = 1;
+	for (int i = 0; i < digits; i++)
+		scale *= 10;
+	unsigned long long scaled = magnitude * scale;
+	unsigned long long quotient = scaled / divisor, remainder = scaled % divisor;
+	if (2 * remainder > divisor || (2 * remainder == divisor && (quotient & 1) != 0))
+		quotient++; // round half to even
+
+	pos = writeDigits(quotient / scale, 1, pos);
+	if (digits > 0) {
+		*pos++ = '.';
+		pos = writeDigits(quotient % scale, digits, pos);
+	}
+	*pos = 0;
+	return pos - buffer;
+}
+
+result_t parseFixed(const char* str, const unsigned int divisor, long long& value)
+{
+	bool negative = *str == '-';
+	if (negative == true || *str == '+')
+		str++;
+
+	unsigned long long integer = 0, fraction = 0, scale = 1;
+	bool digits = false;
+	for (; *str >= '0' && *str <= '9'; str++, digits = true) {
+		integer = integer * 10 + (*str - '0');
+		if (integer > 0xffffffffULL)
+			return RESULT_ERR_OUT_OF_RANGE; // value out of range
+	}
+	if (*str == '.' && divisor > 1) {
+		for (str++; *str >= '0' && *str <= '9'; str++, digits = true)
+			if (scale < 1000000000ULL) { // further digits are irrelevant for the supported divisors
+				fraction = fraction * 10 + (*str - '0');
+				scale *= 10;
+			}
+	}
+	if (digits == false || *str != 0)
+		return RESULT_ERR_INVALID_NUM; // invalid value
+
+	unsigned long long magnitude = integer;
+	if (divisor > 1) {
+		unsigned long long scaled = fraction * divisor;
+		unsigned long long rounded = scaled / scale;
+		if (2 * (scaled % scale) >= scale)
+			rounded++; // round half away from zero
+		magnitude = integer * divisor + rounded;
+	}
+	value = negative ? -(long long)magnitude : (long long)magnitude;
+	return RESULT_OK;
+}
+
+bool StringView::getline(StringView& token, const char separator)
+{
+	if (m_pos >= m_end) {
+		token = StringView();
+		return false;
+	}
+	const char* end = (const char*)memchr(m_pos, separator, m_end - m_pos);
+	if (end == NULL)
+		end = m_end;
+	token = StringView(m_pos, end - m_pos);
+	m_pos = end < m_end ? end + 1 : end;
+	return true;
+}
+
+bool StringView::equals(const char* str, const bool ignoreCase) const
 {
-	cout << "Erroneous item is here:" << endl;
+	size_t length = strlen(str);
+	if (length != (size_t)(m_end - m_pos))
+		return false;
+	if (length == 0)
+		return true;
+	return (ignoreCase ? strncasecmp(m_pos, str, length) : memcmp(m_pos, str, length)) == 0;
+}
+
+bool StringView::copy(char* buffer, const size_t size) const
+{
+	size_t length = m_end - m_pos;
+	if (length >= size)
+		return false;
+	if (length > 0)
+		memcpy(buffer, m_pos, length);
+	buffer[length] = 0;
+	return true;
+}
+
+
+pthread_mutex_t StringPool::s_mutex = PTHREAD_MUTEX_INITIALIZER;
+set<string>* StringPool::s_strings = NULL;
+size_t StringPool::s_references = 0;
+size_t StringPool::s_bytes = 0;
+
+const string& StringPool::intern(const string& str)
+{
+	pthread_mutex_lock(&s_mutex);
+	if (s_strings == NULL)
+		s_strings = new set<string>();
+	pair<set<string>::iterator, bool> result = s_strings->insert(str);
+	if (result.second == true)
+		s_bytes += str.length();
+	s_references++;
+	pthread_mutex_unlock(&s_mutex);
+	return *result.first;
+}
+
+void StringPool::getStats(size_t& count, size_t& references, size_t& bytes)
+{
+	pthread_mutex_lock(&s_mutex);
+	count = s_strings == NULL ? 0 : s_strings->size();
+	references = s_references;
+	bytes = s_bytes;
+	pthread_mutex_unlock(&s_mutex);
+}
+
+void printErrorPos(vector<string>::iterator begin, const vector<string>::iterator end, vector<string>::iterator pos, ostream& output)
+{
+	output << "Erroneous item is here:" << endl;
 	bool first = true;
 	int cnt = 0;
 	if (pos > begin)
@@ -116,7 +266,7 @@ void printErrorPos(vector<string>::iterator begin, const vector<string>::iterato
 		if (first == true)
 			first = false;
 		else {
-			cout << FIELD_SEPARATOR;
+			output << FIELD_SEPARATOR;
 			if (begin <= pos) {
 				cnt++;
 			}
@@ -124,10 +274,10 @@ void printErrorPos(vector<string>::iterator begin, const vector<string>::iterato
 		if (begin < pos) {
 			cnt += (*begin).length();
 		}
-		cout << (*begin++);
+		output << (*begin++);
 	}
-	cout << endl;
-	cout << setw(cnt) << " " << setw(0) << "^" << endl;
+	output << endl;
+	output << setw(cnt) << " " << setw(0) << "^" << endl;
 }
 
 
@@ -246,7 +396,7 @@ result_t DataField::create(vector<string>::iterator& it,
 					}
 					else {
 						found = true;
-						result = templ->derive("", "", "", partType, divisor, values, fields);
+						result = templates->derive(templ, partType, divisor, values, fields);
 					}
 				}
 				if (result != RESULT_OK)
@@ -265,7 +415,7 @@ result_t DataField::create(vector<string>::iterator& it,
 		SingleDataField* add = NULL;
 		const char* typeName = typeStr.c_str();
 		for (size_t i = 0; result == RESULT_OK && add == NULL && i < sizeof(dataTypes) / sizeof(dataTypes[0]); i++) {
-			dataType_t dataType = dataTypes[i];
+			const dataType_t& dataType = dataTypes[i];
 			if (strcasecmp(typeName, dataType.name) == 0) {
 				unsigned char bitCount = dataType.maxBits;
 				unsigned char useLength = (bitCount + 7) / 8;
@@ -341,7 +491,7 @@ result_t DataField::create(vector<string>::iterator& it,
 
 	if (fields.empty() == true || result != RESULT_OK) {
 		while (fields.empty() == false) { // cleanup already created fields
-			delete fields.back();
+			fields.back()->release();
 			fields.pop_back();
 		}
 		return result == RESULT_OK ? RESULT_ERR_INVALID_ARG : result;
@@ -410,7 +560,7 @@ result_t SingleDataField::read(const PartType partType,
 	return RESULT_OK;
 }
 
-result_t SingleDataField::write(istringstream& input,
+result_t SingleDataField::write(StringView& input,
 		const PartType partType, SymbolString& data,
 		unsigned char offset, char separator)
 {
@@ -431,6 +581,16 @@ result_t SingleDataField::write(istringstream& input,
 	return writeSymbols(input, offset, data);
 }
 
+void SingleDataField::compile(DecodeProgram& program)
+{
+	if (program.getPartType() != m_partType)
+		return;
+
+	DecodeOp& op = program.add(this, m_length, hasFullByteOffset(false), hasFullByteOffset(true));
+	if (isIgnored() == false)
+		prepareDecodeOp(op);
+}
+
 
 result_t StringDataField::derive(string name, string comment,
 		string unit, const PartType partType,
@@ -553,18 +713,123 @@ result_t StringDataField::readSymbols(SymbolString& input,
 	return RESULT_OK;
 }
 
-result_t StringDataField::writeSymbols(istringstream& input,
+result_t StringDataField::readValue(SymbolString& input,
+		const unsigned char baseOffset, DecodedValue& value)
+{
+	size_t start = 0, count = m_length;
+	int incr = 1;
+	unsigned char ch, last = 0;
+
+	if (baseOffset + m_length > input.size()) {
+		return RESULT_ERR_INVALID_POS;
+	}
+
+	switch (m_dataType.type)
+	{
+	case bt_dat:
+		value.type = dv_date;
+		break;
+	case bt_tim:
+		value.type = dv_time;
+		value.time.hour = value.time.minute = value.time.second = DECODED_NULL;
+		break;
+	default:
+		value.type = dv_bytes;
+		value.span.position = baseOffset;
+		value.span.length = m_length;
+		return RESULT_OK;
+	}
+
+	if ((m_dataType.flags & REV) != 0) { // reverted binary representation (most significant byte first)
+		start = m_length - 1;
+		incr = -1;
+	}
+
+	// same validation as in readSymbols()
+	for (size_t offset = start, i = 0; i < count; offset += incr, i++) {
+		if (m_length == 4 && i == 2 && m_dataType.type == bt_dat)
+			continue; // skip weekday in between
+		ch = input[baseOffset + offset];
+		if ((m_dataType.flags & BCD) != 0 || m_dataType.type == bt_dat) {
+			if ((ch & 0xf0) > 0x90 || (ch & 0x0f) > 0x09)
+				return RESULT_ERR_OUT_OF_RANGE; // invalid BCD
+			ch = (ch >> 4) * 10 + (ch & 0x0f);
+		}
+		if (m_dataType.type == bt_dat) {
+			if (i + 1 == m_length)
+				value.date.year = (unsigned short)(2000 + ch);
+			else if (ch < 1 || (i == 0 && ch > 31) || (i == 1 && ch > 12))
+				return RESULT_ERR_OUT_OF_RANGE; // invalid date
+			else if (i == 0)
+				value.date.day = ch;
+			else
+				value.date.month = ch;
+			last = ch;
+			continue;
+		}
+		if (m_dataType.replacement != 0 && ch == m_dataType.replacement) {
+			last = ch; // component stays DECODED_NULL
+			continue;
+		}
+		if (m_length == 1) { // truncated time
+			if (i == 0) {
+				ch /= 6; // hours
+				offset -= incr; // repeat for minutes
+				count++;
+			}
+			else
+				ch = (ch % 6) * 10; // minutes
+		}
+		if ((i == 0 && ch > 24) || (i > 0 && (ch > 59 || (last == 24 && ch > 0) )))
+			return RESULT_ERR_OUT_OF_RANGE; // invalid time
+		if (i == 0)
+			value.time.hour = ch;
+		else if (i == 1)
+			value.time.minute = ch;
+		else
+			value.time.second = ch;
+		last = ch;
+	}
+
+	return RESULT_OK;
+}
+
+void StringDataField::prepareDecodeOp(DecodeOp& op)
+{
+	op.code = op_string;
+}
+
+/**
+ * @brief Calculate the week day of a date arithmetically (days beyond the end of the month
+ * continue into the next month).
+ * @param day the day of the month (1-31).
+ * @param month the month (1-12).
+ * @param year the year including the century.
+ * @return the week day (Sun=0 - Sat=6).
+ */
+static unsigned char getWeekday(const unsigned long int day, const unsigned long int month, unsigned long int year)
+{
+	static const unsigned char monthOffsets[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+	if (month < 3)
+		year--;
+	return (unsigned char)((year + year/4 - year/100 + year/400 + monthOffsets[month-1] + day) % 7);
+}
+
+result_t StringDataField::writeSymbols(StringView& input,
 		unsigned char baseOffset, SymbolString& output)
 {
 	size_t start = 0, count = m_length;
 	int incr = 1;
 	unsigned long int value = 0, last = 0, lastLast = 0;
-	string token;
+	StringView token;
+	char digits[MAX_NUMBER_LENGTH];
 
 	if ((m_dataType.flags & REV) != 0) { // reverted binary representation (most significant byte first)
 		start = m_length - 1;
 		incr = -1;
 	}
+	if (baseOffset + m_length > output.size() && output.resize(baseOffset + m_length) != RESULT_OK)
+		return RESULT_ERR_INVALID_POS; // too much data
 
 	if (isIgnored() == true) {
 		for (size_t offset = start, i = 0; i < count; offset += incr, i++) {
@@ -578,20 +843,18 @@ result_t StringDataField::writeSymbols(istringstream& input,
 		switch (m_dataType.type)
 		{
 		case bt_hexstr:
-			while (input.eof() == false && input.peek() == ' ')
+			while (input.peek() == ' ')
 				input.get();
 			if (input.eof() == true) // no more digits
 				value = m_dataType.replacement; // fill up with replacement
 			else {
-				token.clear();
-				token.push_back(input.get());
-				if (input.eof() == true)
-					return RESULT_ERR_INVALID_NUM; // too short hex value
-				token.push_back(input.get());
+				digits[0] = (char)input.get();
 				if (input.eof() == true)
 					return RESULT_ERR_INVALID_NUM; // too short hex value
+				digits[1] = (char)input.get();
+				digits[2] = 0;
 
-				value = parseInt(token.c_str(), 16, 0, 0xff, result);
+				value = parseInt(digits, 16, 0, 0xff, result);
 				if (result != RESULT_OK)
 					return result; // invalid hex value
 			}
@@ -599,40 +862,32 @@ result_t StringDataField::writeSymbols(istringstream& input,
 		case bt_dat:
 			if (m_length == 4 && i == 2)
 				continue; // skip weekday in between
-			if (input.eof() == true || getline(input, token, '.') == 0)
+			if (input.getline(token, '.') == false)
 				return RESULT_ERR_EOF; // incomplete
-			value = parseInt(token.c_str(), 10, 0, 2099, result);
+			if (token.copy(digits, sizeof(digits)) == false)
+				return RESULT_ERR_INVALID_NUM; // invalid date part
+			value = parseInt(digits, 10, 0, 2099, result);
 			if (result != RESULT_OK)
 				return result; // invalid date part
 			if (i + 1 == m_length) {
+				if (value >= 2000)
+					value -= 2000;
+				else if (value > 99)
+					return RESULT_ERR_OUT_OF_RANGE; // invalid year
 				if (m_length == 4) {
-					// calculate local week day
-					struct tm t;
-					t.tm_min = t.tm_sec = 0;
-					t.tm_hour = 12;
-					t.tm_mday = lastLast;
-					t.tm_mon = last-1; // January=0
-					t.tm_year = (value < 100 ? value + 2000 : value) - 1900;
-					t.tm_isdst = 0; // automatic
-					if (mktime(&t) < 0)
-						return RESULT_ERR_INVALID_NUM; // invalid date
-					unsigned char daysSinceSunday = (unsigned char)t.tm_wday; // Sun=0
+					unsigned char daysSinceSunday = getWeekday(lastLast, last, 2000 + value); // Sun=0
 					if ((m_dataType.flags & BCD) != 0)
 						output[baseOffset + offset - incr] = (6+daysSinceSunday) % 7; // Sun=0x06
 					else
 						output[baseOffset + offset - incr] = (daysSinceSunday==0 ? 7 : daysSinceSunday); // Sun=0x07
 				}
-				if (value >= 2000)
-					value -= 2000;
-				else if (value > 99)
-					return RESULT_ERR_OUT_OF_RANGE; // invalid year
 			} else if (value < 1 || (i == 0 && value > 31) || (i == 1 && value > 12))
 				return RESULT_ERR_OUT_OF_RANGE; // invalid date part
 			break;
 		case bt_tim:
-			if (input.eof() == true || getline(input, token, LENGTH_SEPARATOR) == 0)
+			if (input.getline(token, LENGTH_SEPARATOR) == false)
 				return RESULT_ERR_EOF; // incomplete
-			if (m_dataType.replacement != 0 && strcmp(token.c_str(), NULL_VALUE) == 0) {
+			if (m_dataType.replacement != 0 && token.equals(NULL_VALUE) == true) {
 				value = m_dataType.replacement;
 				if (m_length == 1) { // truncated time
 					if (i == 0) {
@@ -646,7 +901,9 @@ result_t StringDataField::writeSymbols(istringstream& input,
 				}
 				break;
 			}
-			value = parseInt(token.c_str(), 10, 0, 59, result);
+			if (token.copy(digits, sizeof(digits)) == false)
+				return RESULT_ERR_INVALID_NUM; // invalid time part
+			value = parseInt(digits, 10, 0, 59, result);
 			if (result != RESULT_OK)
 				return result; // invalid time part
 			if ((i == 0 && value > 24) || (i > 0 && (last == 24 && value > 0) ))
@@ -670,7 +927,7 @@ result_t StringDataField::writeSymbols(istringstream& input,
 				value = m_dataType.replacement;
 			else {
 				value = input.get();
-				if (input.eof() == true || value < 0x20)
+				if (value < 0x20)
 					value = m_dataType.replacement;
 			}
 			break;
@@ -694,6 +951,118 @@ result_t StringDataField::writeSymbols(istringstream& input,
 }
 
 
+/**
+ * @brief Reads a raw numeric value with all type properties known at compile time.
+ * @tparam length the number of symbols.
+ * @tparam reverse whether the most significant symbol comes first.
+ * @tparam bcd whether the symbols are in BCD.
+ * @tparam slice whether only some bits of the symbols are used.
+ */
+template<unsigned char length, bool reverse, bool bcd, bool slice>
+static result_t readNumeric(const unsigned char* symbols, const unsigned char shift,
+		const unsigned int mask, const unsigned int replacement, unsigned int& value)
+{
+	value = 0;
+	if (bcd) {
+		for (unsigned int i = 0, exp = 1; i < length; i++, exp *= 100) {
+			unsigned char ch = symbols[reverse ? length - 1 - i : i];
+			if (ch == replacement) {
+				value = replacement;
+				return RESULT_OK;
+			}
+			if ((ch & 0xf0) > 0x90 || (ch & 0x0f) > 0x09)
+				return RESULT_ERR_OUT_OF_RANGE; // invalid BCD
+
+			value += ((ch >> 4) * 10 + (ch & 0x0f)) * exp;
+		}
+		return RESULT_OK;
+	}
+	for (unsigned int i = length; i > 0; i--)
+		value = (value << 8) | symbols[reverse ? length - i : i - 1];
+	if (slice)
+		value = (value >> shift) & mask;
+	return RESULT_OK;
+}
+
+/**
+ * @brief Writes a raw numeric value with all type properties known at compile time.
+ * @tparam length the number of symbols.
+ * @tparam reverse whether the most significant symbol comes first.
+ * @tparam bcd whether the symbols are in BCD.
+ * @tparam slice whether only some bits of the symbols are used (merged into the existing symbol).
+ */
+template<unsigned char length, bool reverse, bool bcd, bool slice>
+static result_t writeNumeric(unsigned int value, const unsigned char shift,
+		const unsigned int mask, const unsigned int replacement, unsigned char* symbols)
+{
+	if (bcd) {
+		for (unsigned int i = 0, exp = 1; i < length; i++, exp *= 100) {
+			unsigned char ch = replacement;
+			if (value != replacement) {
+				ch = (value / exp) % 100;
+				ch = ((ch / 10) << 4) | (ch % 10);
+			}
+			symbols[reverse ? length - 1 - i : i] = ch;
+		}
+		return RESULT_OK;
+	}
+	if (slice) {
+		if ((value & ~mask) != 0)
+			return RESULT_ERR_OUT_OF_RANGE;
+
+		value <<= shift;
+	}
+	for (unsigned int i = 0; i < length; i++, value >>= 8) {
+		if (slice && i == 0)
+			symbols[reverse ? length - 1 : 0] |= (unsigned char)value;
+		else
+			symbols[reverse ? length - 1 - i : i] = (unsigned char)value;
+	}
+	return RESULT_OK;
+}
+
+/**
+ * @brief Returns the @a NumericCodec for the length and the compile time type properties.
+ * @param length the number of symbols (1 to 4).
+ * @return the @a NumericCodec.
+ */
+template<bool reverse, bool bcd, bool slice>
+static const NumericCodec* selectNumericCodec(const unsigned char length)
+{
+	static const NumericCodec codecs[] = {
+		{&readNumeric<1, reverse, bcd, slice>, &writeNumeric<1, reverse, bcd, slice>},
+		{&readNumeric<2, reverse, bcd, slice>, &writeNumeric<2, reverse, bcd, slice>},
+		{&readNumeric<3, reverse, bcd, slice>, &writeNumeric<3, reverse, bcd, slice>},
+		{&readNumeric<4, reverse, bcd, slice>, &writeNumeric<4, reverse, bcd, slice>},
+	};
+	return &codecs[length - 1];
+}
+
+/** the @a NumericCodec selectors indexed by reverse (4), BCD (2), and slice (1). */
+static const NumericCodec* (*const numericCodecSelectors[])(const unsigned char) = {
+	&selectNumericCodec<false, false, false>,
+	&selectNumericCodec<false, false, true>,
+	&selectNumericCodec<false, true, false>,
+	&selectNumericCodec<false, true, true>,
+	&selectNumericCodec<true, false, false>,
+	&selectNumericCodec<true, false, true>,
+	&selectNumericCodec<true, true, false>,
+	&selectNumericCodec<true, true, true>,
+};
+
+NumericDataField::NumericDataField(const string name, const string comment,
+		const string unit, const dataType_t& dataType, const PartType partType,
+		const unsigned char length, const unsigned char bitCount, const unsigned char bitOffset)
+	: SingleDataField(name, comment, unit, dataType, partType, length),
+	  m_bitCount(bitCount), m_bitOffset(bitOffset),
+	  m_shift((dataType.flags & BCD) != 0 ? 0 : bitOffset),
+	  m_mask(((dataType.flags & BCD) != 0 || (bitCount % 8) == 0) ? 0xffffffff : (1 << bitCount) - 1)
+{
+	bool slice = m_shift != 0 || m_mask != 0xffffffff;
+	unsigned int index = ((dataType.flags & REV) != 0 ? 4 : 0) | ((dataType.flags & BCD) != 0 ? 2 : 0) | (slice ? 1 : 0);
+	m_codec = numericCodecSelectors[index](length < 1 ? 1 : length > 4 ? 4 : length);
+}
+
 bool NumericDataField::hasFullByteOffset(bool after)
 {
 	return m_length > 1 || (m_bitCount % 8) == 0
@@ -715,89 +1084,76 @@ void NumericDataField::dump(ostream& output)
 result_t NumericDataField::readRawValue(SymbolString& input,
 		unsigned char baseOffset, unsigned int& value)
 {
-	size_t start = 0, count = m_length;
-	int incr = 1;
-	unsigned char ch;
-
 	if (baseOffset + m_length > input.size())
 		return RESULT_ERR_INVALID_POS; // not enough data available
 
-	if ((m_dataType.flags & REV) != 0) { // reverted binary representation (most significant byte first)
-		start = m_length - 1;
-		incr = -1;
-	}
+	return m_codec->read(input.data() + baseOffset, m_shift, m_mask, m_dataType.replacement, value);
+}
 
-	value = 0;
-	for (size_t offset = start, i = 0, exp = 1; i < count; offset += incr, i++) {
-		ch = input[baseOffset + offset];
-		if ((m_dataType.flags & BCD) != 0) {
-			if (ch == m_dataType.replacement) {
-				value = m_dataType.replacement;
-				return RESULT_OK;
-			}
-			if ((ch & 0xf0) > 0x90 || (ch & 0x0f) > 0x09)
-				return RESULT_ERR_OUT_OF_RANGE; // invalid BCD
+result_t NumericDataField::writeRawValue(unsigned int value,
+		unsigned char baseOffset, SymbolString& output)
+{
+	if (baseOffset + m_length > output.size() && output.resize(baseOffset + m_length) != RESULT_OK)
+		return RESULT_ERR_INVALID_POS; // too much data
 
-			ch = (ch >> 4) * 10 + (ch & 0x0f);
-			value += ch * exp;
-			exp *= 100;
-		}
-		else {
-			value |= ch * exp;
-			exp <<= 8;
-		}
-	}
+	return m_codec->write(value, m_shift, m_mask, m_dataType.replacement, &output[baseOffset]);
+}
 
-	if ((m_dataType.flags & BCD) == 0) {
-		value >>= m_bitOffset;
-		if ((m_bitCount % 8) != 0)
-			value &= (1 << m_bitCount) - 1;
-	}
+result_t NumericDataField::writeSymbols(StringView& input,
+		unsigned char baseOffset, SymbolString& output)
+{
+	unsigned int value;
 
-	return RESULT_OK;
+	result_t result = parseRawValue(input, value);
+	if (result != RESULT_OK)
+		return result;
+
+	return writeRawValue(value, baseOffset, output);
 }
 
-result_t NumericDataField::writeRawValue(unsigned int value,
-		unsigned char baseOffset, SymbolString& output)
+result_t NumericDataField::writeBits(StringView& input, unsigned char& symbol)
 {
-	size_t start = 0, count = m_length;
-	int incr = 1;
-	unsigned char ch;
+	if (hasFullByteOffset(false) == true)
+		return RESULT_ERR_INVALID_ARG; // no bit field
 
-	if ((m_dataType.flags & REV) != 0) { // reverted binary representation (most significant byte first)
-		start = m_length - 1;
-		incr = -1;
-	}
+	unsigned int value;
 
-	if ((m_dataType.flags & BCD) == 0) {
-		if ((m_bitCount % 8) != 0 && (value & ~((1 << m_bitCount) - 1)) != 0)
-			return RESULT_ERR_OUT_OF_RANGE;
+	result_t result = parseRawValue(input, value);
+	if (result != RESULT_OK)
+		return result;
 
-		value <<= m_bitOffset;
-	}
-	for (size_t offset = start, i = 0, exp = 1; i < count; offset += incr, i++) {
-		if ((m_dataType.flags & BCD) != 0) {
-			if (value == m_dataType.replacement)
-				ch = m_dataType.replacement;
-			else {
-				ch = (value / exp) % 100;
-				ch = ((ch / 10) << 4) | (ch % 10);
-			}
-			exp = exp * 100;
-		}
-		else {
-			ch = (value / exp) & 0xff;
-			exp = exp << 8;
-		}
-		if (offset == start && (m_bitCount % 8) != 0 && baseOffset + offset < output.size())
-			output[baseOffset + offset] |= ch;
-		else
-			output[baseOffset + offset] = ch;
-	}
+	return m_codec->write(value, m_shift, m_mask, m_dataType.replacement, &symbol);
+}
 
-	return RESULT_OK;
+
+/**
+ * @brief Format a raw numeric value.
+ * @param value the raw value (already shifted and masked).
+ * @param negative whether the raw value is a negative signed value.
+ * @param signRange the value range to subtract from negative values (0 for 32 bits).
+ * @param divisor the divisor to apply, or 1 for none.
+ * @param precision the precision for formatting with divisor.
+ * @param output the ostringstream to append the formatted value to.
+ */
+static void formatNumber(const unsigned int value, const bool negative, const unsigned int signRange,
+		const unsigned int divisor, const int precision, ostringstream& output)
+{
+	long long signedValue = value;
+	if (negative == true)
+		signedValue = (int) (value - signRange); // negative signed value
+	char buffer[MAX_NUMBER_LENGTH];
+	output.write(buffer, formatFixed(signedValue, divisor, precision, buffer));
 }
 
+void NumericDataField::prepareDecodeOp(DecodeOp& op)
+{
+	op.read = m_codec->read;
+	op.shift = m_shift;
+	op.mask = m_mask;
+	op.signBit = (m_dataType.flags & SIG) != 0 ? 1 << (m_bitCount - 1) : 0;
+	op.signRange = m_bitCount >= 32 ? 0 : 1 << m_bitCount;
+	op.replacement = m_dataType.replacement;
+}
 
 result_t NumberDataField::derive(string name, string comment,
 		string unit, const PartType partType,
@@ -839,7 +1195,6 @@ result_t NumberDataField::readSymbols(SymbolString& input,
 		unsigned char baseOffset, ostringstream& output)
 {
 	unsigned int value = 0;
-	int signedValue;
 
 	result_t result = readRawValue(input, baseOffset, value);
 	if (result != RESULT_OK)
@@ -853,75 +1208,46 @@ result_t NumberDataField::readSymbols(SymbolString& input,
 	}
 
 	bool negative = (m_dataType.flags & SIG) != 0 && (value & (1 << (m_bitCount - 1))) != 0;
-	if (m_bitCount == 32) {
-		if (negative == false) {
-			if (m_divisor <= 1)
-				output << static_cast<unsigned>(value);
-			else
-				output << setprecision((m_bitCount % 8) == 0 ? m_dataType.precisionOrFirstBit : 0)
-				       << fixed << static_cast<float>(value / (float) m_divisor);
-			return RESULT_OK;
-		}
-		signedValue = (int) value; // negative signed value
-	}
-	else if (negative) // negative signed value
-		signedValue = (int) value - (1 << m_bitCount);
-	else
-		signedValue = (int) value;
-
-	if (m_divisor <= 1)
-		output << static_cast<int>(signedValue);
-	else
-		output << setprecision((m_bitCount % 8) == 0 ? m_dataType.precisionOrFirstBit : 0)
-		       << fixed << static_cast<float>(signedValue / (float) m_divisor);
+	formatNumber(value, negative, m_bitCount >= 32 ? 0 : 1 << m_bitCount, m_divisor,
+		(m_bitCount % 8) == 0 ? m_dataType.precisionOrFirstBit : 0, output);
 
 	return RESULT_OK;
 }
 
-result_t NumberDataField::writeSymbols(istringstream& input,
-		unsigned char baseOffset, SymbolString& output)
+void NumberDataField::prepareDecodeOp(DecodeOp& op)
 {
-	unsigned int value;
+	NumericDataField::prepareDecodeOp(op);
+	op.code = op_number;
+	op.divisor = m_divisor;
+	op.precision = (m_bitCount % 8) == 0 ? m_dataType.precisionOrFirstBit : 0;
+}
 
-	const char* str = input.str().c_str();
-	if (isIgnored() == true || strcasecmp(str, NULL_VALUE) == 0)
+result_t NumberDataField::parseRawValue(StringView& input, unsigned int& value)
+{
+	if (isIgnored() == true || input.equals(NULL_VALUE, true) == true)
 		value = m_dataType.replacement; // replacement value
-	else if (str == NULL || *str == 0)
+	else if (input.eof() == true)
 		return RESULT_ERR_EOF; // input too short
 	else {
-		char* strEnd = NULL;
-		if (m_divisor <= 1) {
-			if ((m_dataType.flags & SIG) != 0) {
-				int signedValue = strtol(str, &strEnd, 10);
-				if (signedValue < 0 && m_bitCount != 32)
-					value = (unsigned int) (signedValue + (1 << m_bitCount));
-				else
-					value = (unsigned int) signedValue;
-			}
+		char str[MAX_NUMBER_LENGTH];
+		if (input.copy(str, sizeof(str)) == false)
+			return RESULT_ERR_INVALID_NUM; // too long for a number
+		long long signedValue;
+		result_t result = parseFixed(str, m_divisor, signedValue);
+		if (result != RESULT_OK)
+			return result;
+		if ((m_dataType.flags & SIG) != 0) {
+			if (signedValue < -(1LL << (8 * m_length)) || signedValue >= (1LL << (8 * m_length)))
+				return RESULT_ERR_OUT_OF_RANGE; // value out of range
+			if (signedValue < 0 && m_bitCount != 32)
+				value = (unsigned int) (signedValue + (1 << m_bitCount));
 			else
-				value = strtoul(str, &strEnd, 10);
-			if (strEnd == NULL || *strEnd != 0)
-				return RESULT_ERR_INVALID_NUM; // invalid value
+				value = (unsigned int) signedValue;
 		}
 		else {
-			char* strEnd = NULL;
-			double dvalue = strtod(str, &strEnd);
-			if (strEnd == NULL || *strEnd != 0)
-				return RESULT_ERR_INVALID_NUM; // invalid value
-			dvalue = round(dvalue * m_divisor);
-			if ((m_dataType.flags & SIG) != 0) {
-				if (dvalue < -(1LL << (8 * m_length)) || dvalue >= (1LL << (8 * m_length)))
-					return RESULT_ERR_OUT_OF_RANGE; // value out of range
-				if (dvalue < 0 && m_bitCount != 32)
-					value = (unsigned int) (dvalue + (1 << m_bitCount));
-				else
-					value = (unsigned int) dvalue;
-			}
-			else {
-				if (dvalue < 0.0 || dvalue >= (1LL << (8 * m_length)))
-					return RESULT_ERR_OUT_OF_RANGE; // value out of range
-				value = (unsigned int) dvalue;
-			}
+			if (signedValue < 0 || signedValue >= (1LL << (8 * m_length)))
+				return RESULT_ERR_OUT_OF_RANGE; // value out of range
+			value = (unsigned int) signedValue;
 		}
 
 		if ((m_dataType.flags & SIG) != 0) { // signed value
@@ -936,7 +1262,77 @@ result_t NumberDataField::writeSymbols(istringstream& input,
 			return RESULT_ERR_OUT_OF_RANGE; // value out of range
 	}
 
-	return writeRawValue(value, baseOffset, output);
+	return RESULT_OK;
+}
+
+
+ValueList::ValueList(const map<unsigned int, string>& values)
+	: m_refCount(1), m_minValue(0)
+{
+	m_values.reserve(values.size());
+	m_texts.reserve(values.size());
+	for (map<unsigned int, string>::const_iterator it = values.begin(); it != values.end(); it++) {
+		m_values.push_back(it->first);
+		m_texts.push_back(it->second);
+	}
+	if (m_values.empty() == true)
+		return;
+
+	m_minValue = m_values.front();
+	if (m_values.back() - m_minValue < MAX_DENSE_RANGE) {
+		m_dense.resize(m_values.back() - m_minValue + 1, 0);
+		for (size_t index = 0; index < m_values.size(); index++)
+			m_dense[m_values[index] - m_minValue] = (unsigned short)(index + 1);
+	}
+
+	size_t size = 4;
+	while (size < 2 * m_texts.size())
+		size <<= 1;
+	m_hash.resize(size, 0);
+	for (size_t index = 0; index < m_texts.size(); index++) {
+		size_t pos = hash(m_texts[index].data(), m_texts[index].length()) & (size - 1);
+		while (m_hash[pos] != 0 && m_texts[m_hash[pos] - 1] != m_texts[index])
+			pos = (pos + 1) & (size - 1);
+		if (m_hash[pos] == 0)
+			m_hash[pos] = (unsigned int)(index + 1); // keep the lowest value for duplicate texts
+	}
+}
+
+const string* ValueList::find(const unsigned int value) const
+{
+	if (m_dense.empty() == false) {
+		if (value < m_minValue || value - m_minValue >= m_dense.size())
+			return NULL;
+		unsigned short index = m_dense[value - m_minValue];
+		return index == 0 ? NULL : &m_texts[index - 1];
+	}
+	vector<unsigned int>::const_iterator it = lower_bound(m_values.begin(), m_values.end(), value);
+	if (it == m_values.end() || *it != value)
+		return NULL;
+	return &m_texts[it - m_values.begin()];
+}
+
+bool ValueList::find(const StringView& text, unsigned int& value) const
+{
+	if (m_hash.empty() == true)
+		return false;
+	size_t size = m_hash.size(), length = text.length();
+	for (size_t pos = hash(text.data(), length) & (size - 1); m_hash[pos] != 0; pos = (pos + 1) & (size - 1)) {
+		const string& candidate = m_texts[m_hash[pos] - 1];
+		if (candidate.length() == length && memcmp(candidate.data(), text.data(), length) == 0) {
+			value = m_values[m_hash[pos] - 1];
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned int ValueList::hash(const char* text, const size_t length)
+{
+	unsigned int hash = 2166136261U; // FNV-1a
+	for (const char* end = text + length; text < end; text++)
+		hash = (hash ^ (unsigned char)*text) * 16777619U;
+	return hash;
 }
 
 
@@ -960,11 +1356,10 @@ result_t ValueListDataField::derive(string name, string comment,
 		if (values.begin()->first < m_dataType.minValueOrLength
 			|| values.rbegin()->first > m_dataType.maxValueOrLength)
 			return RESULT_ERR_INVALID_ARG; // cannot use divisor != 1 for value list field
+		fields.push_back(new ValueListDataField(name, comment, unit, m_dataType, partType, m_length, m_bitCount, values));
 	}
-	else
-		values = m_values;
-
-	fields.push_back(new ValueListDataField(name, comment, unit, m_dataType, partType, m_length, m_bitCount, values));
+	else // share the assignments of the template
+		fields.push_back(new ValueListDataField(name, comment, unit, m_dataType, partType, m_length, m_bitCount, m_values));
 
 	return RESULT_OK;
 }
@@ -972,13 +1367,10 @@ result_t ValueListDataField::derive(string name, string comment,
 void ValueListDataField::dump(ostream& output)
 {
 	NumericDataField::dump(output);
-	bool first = true;
-	for (map<unsigned int, string>::iterator it = m_values.begin(); it != m_values.end(); it++) {
-		if (first == true)
-			first = false;
-		else
+	for (size_t index = 0; index < m_values->size(); index++) {
+		if (index > 0)
 			output << VALUE_SEPARATOR;
-		output << static_cast<unsigned>(it->first) << "=" << it->second;
+		output << static_cast<unsigned>(m_values->getValue(index)) << "=" << m_values->getText(index);
 	}
 	output << FIELD_SEPARATOR;
 	output << m_unit << FIELD_SEPARATOR << m_comment << FIELD_SEPARATOR;
@@ -995,9 +1387,9 @@ result_t ValueListDataField::readSymbols(SymbolString& input,
 
 	output << setw(0) << dec; // initialize output
 
-	map<unsigned int, string>::iterator it = m_values.find(value);
-	if (it != m_values.end()) {
-		output << it->second;
+	const string* text = m_values->find(value);
+	if (text != NULL) {
+		output << *text;
 		return RESULT_OK;
 	}
 
@@ -1009,20 +1401,27 @@ result_t ValueListDataField::readSymbols(SymbolString& input,
 	return RESULT_ERR_NOTFOUND; // value assignment not found
 }
 
-result_t ValueListDataField::writeSymbols(istringstream& input,
-		unsigned char baseOffset, SymbolString& output)
+void ValueListDataField::prepareDecodeOp(DecodeOp& op)
 {
-	if (isIgnored() == true)
-		return writeRawValue(m_dataType.replacement, baseOffset, output); // replacement value
+	NumericDataField::prepareDecodeOp(op);
+	op.code = op_list;
+	op.values = m_values;
+}
 
-	const char* str = input.str().c_str();
+result_t ValueListDataField::parseRawValue(StringView& input, unsigned int& value)
+{
+	if (isIgnored() == true) {
+		value = m_dataType.replacement; // replacement value
+		return RESULT_OK;
+	}
 
-	for (map<unsigned int, string>::iterator it = m_values.begin(); it != m_values.end(); it++)
-		if (it->second.compare(str) == 0)
-			return writeRawValue(it->first, baseOffset, output);
+	if (m_values->find(input, value) == true)
+		return RESULT_OK;
 
-	if (strcasecmp(str, NULL_VALUE) == 0)
-		return writeRawValue(m_dataType.replacement, baseOffset, output); // replacement value
+	if (input.equals(NULL_VALUE, true) == true) {
+		value = m_dataType.replacement; // replacement value
+		return RESULT_OK;
+	}
 
 	return RESULT_ERR_NOTFOUND; // value assignment not found
 }
@@ -1068,7 +1467,7 @@ DataFieldSet* DataFieldSet::createIdentFields()
 DataFieldSet::~DataFieldSet()
 {
 	while (m_fields.empty() == false) {
-		delete m_fields.back();
+		m_fields.back()->release();
 		m_fields.pop_back();
 	}
 }
@@ -1154,11 +1553,31 @@ result_t DataFieldSet::read(const PartType partType,
 	return RESULT_OK;
 }
 
-result_t DataFieldSet::write(istringstream& input,
+/**
+ * @brief Store the packed bits of consecutive bit fields in a symbol at once.
+ * @param data the @a SymbolString to store the bits in, extended if necessary.
+ * @param index the index of the symbol.
+ * @param bits the packed bits.
+ * @return @a RESULT_OK on success, or an error code.
+ */
+static result_t storeBits(SymbolString& data, const size_t index, const unsigned char bits)
+{
+	if (index >= data.size() && data.resize(index + 1) != RESULT_OK)
+		return RESULT_ERR_INVALID_POS; // too much data
+
+	data[index] |= bits;
+	return RESULT_OK;
+}
+
+result_t DataFieldSet::write(StringView& input,
 		const PartType partType, SymbolString& data,
 		unsigned char offset, char separator)
 {
-	string token;
+	StringView token;
+	unsigned char headerLength = partType == pt_masterData ? 5 : 1; // skip QQ ZZ PB SB NN or NN
+	bool packBits = m_fields.size() > 1 && (partType == pt_masterData || partType == pt_slaveData);
+	unsigned char bits = 0; // the packed bits of consecutive bit fields sharing the same symbol
+	int bitsOffset = -1; // the offset of the symbol in @a bits, or -1 for none
 
 	bool previousFullByteOffset = true;
 	for (vector<SingleDataField*>::iterator it = m_fields.begin(); it < m_fields.end(); it++) {
@@ -1166,21 +1585,35 @@ result_t DataFieldSet::write(istringstream& input,
 		if (partType != pt_any && field->getPartType() != partType)
 			continue;
 
-		if (previousFullByteOffset == false && field->hasFullByteOffset(false) == false)
+		bool sharedOffset = previousFullByteOffset == false && field->hasFullByteOffset(false) == false;
+		if (sharedOffset)
 			offset--;
 
 		result_t result;
-		if (m_fields.size() > 1) {
-			if (field->isIgnored() == true)
-				token.clear();
-			else if (getline(input, token, separator) == 0)
-				token.clear();
+		if (bitsOffset >= 0 && sharedOffset == false) {
+			result = storeBits(data, bitsOffset + headerLength, bits);
+			if (result != RESULT_OK)
+				return result;
+			bitsOffset = -1;
+		}
 
-			istringstream single(token);
-			result = (*it)->write(single, partType, data, offset, separator);
+		if (m_fields.size() > 1) {
+			if (field->isIgnored() == true || input.getline(token, separator) == false)
+				token = StringView();
+
+			StringView single = token;
+			if (packBits == true && field->hasFullByteOffset(false) == false) {
+				if (bitsOffset < 0) {
+					bits = 0;
+					bitsOffset = offset;
+				}
+				result = field->writeBits(single, bits);
+			}
+			else
+				result = field->write(single, partType, data, offset, separator);
 		}
 		else
-			result = (*it)->write(input, partType, data, offset, separator);
+			result = field->write(input, partType, data, offset, separator);
 
 		if (result != RESULT_OK)
 			return result;
@@ -1188,15 +1621,242 @@ result_t DataFieldSet::write(istringstream& input,
 		offset += field->getLength(partType);
 		previousFullByteOffset = field->hasFullByteOffset(true);
 	}
+	if (bitsOffset >= 0)
+		return storeBits(data, bitsOffset + headerLength, bits);
+
+	return RESULT_OK;
+}
+
+
+void DataFieldSet::compile(DecodeProgram& program)
+{
+	for (vector<SingleDataField*>::iterator it = m_fields.begin(); it < m_fields.end(); it++)
+		(*it)->compile(program);
+}
+
+
+void DecodeProgram::compile(DataField* field, const PartType partType, const unsigned char offset)
+{
+	m_ops.clear();
+	m_partType = partType;
+	m_headerLength = partType == pt_masterData ? 5 : 1; // skip QQ ZZ PB SB NN or NN
+	m_offset = offset;
+	m_previousFullByteOffset = true;
+	field->compile(*this);
+
+	// let consecutive bit fields in the same symbol share a single load
+	for (size_t index = 1; index < m_ops.size(); index++) {
+		DecodeOp& op = m_ops[index];
+		const DecodeOp& previous = m_ops[index-1];
+		op.fused = isBitField(op) && isBitField(previous) && op.position == previous.position;
+	}
+}
+
+DecodeOp& DecodeProgram::add(SingleDataField* field, const unsigned char length,
+		const bool fullByteBefore, const bool fullByteAfter)
+{
+	if (m_previousFullByteOffset == false && fullByteBefore == false)
+		m_offset--;
+
+	DecodeOp op;
+	op.code = field->isIgnored() == true ? op_skip : op_field;
+	op.position = m_offset + m_headerLength;
+	op.length = length;
+	op.offset = m_offset;
+	op.read = NULL;
+	op.fused = false;
+	op.shift = 0;
+	op.mask = 0xffffffff;
+	op.signBit = 0;
+	op.signRange = 0;
+	op.replacement = 0;
+	op.divisor = 1;
+	op.precision = 0;
+	op.values = NULL;
+	op.field = field;
+
+	m_offset += length;
+	m_previousFullByteOffset = fullByteAfter;
+	m_ops.push_back(op);
+	return m_ops.back();
+}
+
+result_t DecodeProgram::run(SymbolString& data, ostringstream& output,
+		bool leadingSeparator, char separator) const
+{
+	const unsigned char* symbols = data.data();
+	const size_t size = data.size();
+	unsigned char bits = 0;
+
+	for (vector<DecodeOp>::const_iterator op = m_ops.begin(); op != m_ops.end(); op++) {
+		if (op->code == op_skip) {
+			if (op->position + op->length > size)
+				return RESULT_ERR_INVALID_POS;
+			continue;
+		}
+		if (op->code == op_string || op->code == op_field) {
+			result_t result = op->field->read(m_partType, data, op->offset, output, leadingSeparator, false, separator);
+			if (result != RESULT_OK)
+				return result;
+			leadingSeparator = true;
+			continue;
+		}
+
+		if (leadingSeparator == true)
+			output << separator;
+		leadingSeparator = true;
+
+		unsigned int value;
+		if (op->fused == true)
+			value = (bits >> op->shift) & op->mask; // same symbol as the previous bit field
+		else {
+			if (op->position + op->length > size)
+				return RESULT_ERR_INVALID_POS; // not enough data available
+
+			result_t result = op->read(symbols + op->position, op->shift, op->mask, op->replacement, value);
+			if (result != RESULT_OK)
+				return result;
+			bits = symbols[op->position];
+		}
+
+		output << setw(0) << dec; // initialize output
+
+		if (op->code == op_list) {
+			const string* text = op->values->find(value);
+			if (text != NULL)
+				output << *text;
+			else if (value == op->replacement)
+				output << NULL_VALUE;
+			else
+				return RESULT_ERR_NOTFOUND; // value assignment not found
+			continue;
+		}
+
+		if (value == op->replacement)
+			output << NULL_VALUE;
+		else
+			formatNumber(value, (value & op->signBit) != 0, op->signRange, op->divisor, op->precision, output);
+	}
 
 	return RESULT_OK;
 }
 
+result_t DecodeProgram::decode(SymbolString& data, DecodedValues& values) const
+{
+	const unsigned char* symbols = data.data();
+	const size_t size = data.size();
+
+	unsigned char bits = 0;
+
+	values.m_program = this;
+	values.m_count = 0;
+	for (vector<DecodeOp>::const_iterator op = m_ops.begin(); op != m_ops.end(); op++) {
+		if (op->fused == false && op->position + op->length > size)
+			return RESULT_ERR_INVALID_POS; // not enough data available
+		if (op->code == op_skip)
+			continue;
+		if (values.m_count >= MAX_DECODED_VALUES)
+			return RESULT_ERR_OVERFLOW;
+
+		DecodedValue& value = values.m_values[values.m_count++];
+		value.op = &*op;
+		value.raw = 0;
+		if (op->code == op_string) {
+			result_t result = static_cast<StringDataField*>(op->field)->readValue(data, (unsigned char)op->position, value);
+			if (result != RESULT_OK)
+				return result;
+			continue;
+		}
+		if (op->code == op_field) {
+			value.type = dv_bytes; // formatted by the field itself
+			value.span.position = (unsigned char)op->position;
+			value.span.length = op->length;
+			continue;
+		}
+
+		if (op->fused == true)
+			value.raw = (bits >> op->shift) & op->mask; // same symbol as the previous bit field
+		else {
+			result_t result = op->read(symbols + op->position, op->shift, op->mask, op->replacement, value.raw);
+			if (result != RESULT_OK)
+				return result;
+			bits = symbols[op->position];
+		}
+
+		if (op->code == op_list) {
+			const string* text = op->values->find(value.raw);
+			if (text != NULL) {
+				value.type = dv_enum;
+				value.assignment.value = value.raw;
+				value.assignment.text = text;
+			}
+			else if (value.raw == op->replacement)
+				value.type = dv_null;
+			else
+				return RESULT_ERR_NOTFOUND; // value assignment not found
+			continue;
+		}
+
+		if (value.raw == op->replacement) {
+			value.type = dv_null;
+			continue;
+		}
+		long long number = value.raw;
+		if ((value.raw & op->signBit) != 0)
+			number = (int) (value.raw - op->signRange); // negative signed value
+		if (op->divisor <= 1) {
+			value.type = dv_int;
+			value.integer = number;
+		}
+		else {
+			value.type = dv_double;
+			value.number = (double)number / op->divisor;
+		}
+	}
+	values.m_data = data;
+
+	return RESULT_OK;
+}
+
+
+string DecodedValues::getName(const size_t index) const
+{
+	return m_values[index].op->field->getName();
+}
+
+result_t DecodedValues::format(ostringstream& output, bool leadingSeparator, char separator)
+{
+	for (size_t index = 0; index < m_count; index++) {
+		const DecodedValue& value = m_values[index];
+		const DecodeOp* op = value.op;
+		if (leadingSeparator == true)
+			output << separator;
+		leadingSeparator = true;
+
+		if (op->code == op_string || op->code == op_field) {
+			result_t result = op->field->read(m_program->getPartType(), m_data, op->offset, output, false, false, separator);
+			if (result != RESULT_OK)
+				return result;
+			continue;
+		}
+
+		output << setw(0) << dec; // initialize output
+		if (value.type == dv_null)
+			output << NULL_VALUE;
+		else if (value.type == dv_enum)
+			output << *value.assignment.text;
+		else
+			formatNumber(value.raw, (value.raw & op->signBit) != 0, op->signRange, op->divisor, op->precision, output);
+	}
+
+	return RESULT_OK;
+}
 
 void DataFieldTemplates::clear()
 {
 	for (map<string, DataField*>::iterator it=m_fieldsByName.begin(); it!=m_fieldsByName.end(); it++) {
-		delete it->second;
+		releaseDerived(it->second);
+		it->second->release();
 		it->second = NULL;
 	}
 	m_fieldsByName.clear();
@@ -1210,7 +1870,8 @@ result_t DataFieldTemplates::add(DataField* field, bool replace)
 		if (replace == false)
 			return RESULT_ERR_DUPLICATE; // duplicate key
 
-		delete it->second;
+		releaseDerived(it->second);
+		it->second->release();
 		it->second = field;
 
 		return RESULT_OK;
@@ -1231,7 +1892,7 @@ result_t DataFieldTemplates::addFromFile(vector<string>& row, void* arg, vector<
 
 	result = add(field);
 	if (result != RESULT_OK)
-		delete field;
+		field->release();
 
 	return result;
 }
@@ -1245,3 +1906,49 @@ DataField* DataFieldTemplates::get(const string name)
 	return ref->second;
 }
 
+result_t DataFieldTemplates::derive(DataField* templ, const PartType partType,
+		unsigned int divisor, map<unsigned int, string> values,
+		vector<SingleDataField*>& fields)
+{
+	if (divisor != 0 || values.empty() == false)
+		return templ->derive("", "", "", partType, divisor, values, fields); // individual instance
+
+	pair<DataField*, PartType> key(templ, partType);
+	pthread_mutex_lock(&m_mutex);
+	map<pair<DataField*, PartType>, vector<SingleDataField*> >::iterator it = m_derived.find(key);
+	if (it == m_derived.end()) {
+		vector<SingleDataField*> derived;
+		result_t result = templ->derive("", "", "", partType, divisor, values, derived);
+		if (result != RESULT_OK) {
+			pthread_mutex_unlock(&m_mutex);
+			for (vector<SingleDataField*>::iterator field = derived.begin(); field != derived.end(); field++)
+				(*field)->release();
+			return result;
+		}
+		it = m_derived.insert(make_pair(key, derived)).first;
+	}
+	for (vector<SingleDataField*>::iterator field = it->second.begin(); field != it->second.end(); field++) {
+		(*field)->acquire();
+		fields.push_back(*field);
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	return RESULT_OK;
+}
+
+void DataFieldTemplates::releaseDerived(DataField* templ)
+{
+	pthread_mutex_lock(&m_mutex);
+	map<pair<DataField*, PartType>, vector<SingleDataField*> >::iterator it = m_derived.begin();
+	while (it != m_derived.end()) {
+		if (it->first.first != templ) {
+			it++;
+			continue;
+		}
+		for (vector<SingleDataField*>::iterator field = it->second.begin(); field != it->second.end(); field++)
+			(*field)->release();
+		m_derived.erase(it++);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
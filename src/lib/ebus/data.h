@@ -28,6 +28,8 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <pthread.h>
 
 using namespace std;
 
@@ -96,18 +98,168 @@ typedef struct {
  */
 unsigned int parseInt(const char* str, int base, const unsigned int minValue, const unsigned int maxValue, result_t& result, unsigned int* length=NULL);
 
+/** the maximum length of a number formatted by @a formatFixed() including the terminating zero. */
+#define MAX_NUMBER_LENGTH 32
+
 /**
- * @brief Print the error position of the iterator to stdout.
+ * @brief Format a fixed-point number independent of the locale.
+ * The exact decimal value is rounded to the precision with ties to even, which is the same as
+ * the stream formatting of exactly representable binary fractions (e.g. divisor 16 or 256).
+ * @param value the signed binary value.
+ * @param divisor the divisor to apply, or 1 for none.
+ * @param precision the number of fraction digits (0 to 9) when formatting with divisor.
+ * @param buffer the buffer of at least @a MAX_NUMBER_LENGTH characters to write the zero terminated text to.
+ * @return the number of characters written (excluding the terminating zero).
+ */
+size_t formatFixed(const long long value, const unsigned int divisor, const int precision, char* buffer);
+
+/**
+ * @brief Parse a fixed-point number independent of the locale.
+ * The decimal value is multiplied with the divisor and rounded half away from zero.
+ * @param str the string to parse (optional sign, digits, and with divisor optional fraction).
+ * @param divisor the divisor to apply, or 1 for none.
+ * @param value the variable in which to store the signed binary value.
+ * @return @a RESULT_OK on success, or an error code.
+ */
+result_t parseFixed(const char* str, const unsigned int divisor, long long& value);
+
+/**
+ * @brief Print the error position of the iterator.
  * @param begin the iterator to the beginning of the items.
  * @param end the iterator to the end of the items.
  * @param pos the iterator with the erroneous position.
- * @param separator the character to place between items.
+ * @param output the ostream to print to.
+ */
+void printErrorPos(vector<string>::iterator begin, const vector<string>::iterator end, vector<string>::iterator pos, ostream& output=cout);
+
+
+/**
+ * @brief A process wide pool of immutable strings storing each distinct string only once,
+ * used for the names, comments, and units of fields and messages.
+ */
+class StringPool
+{
+public:
+
+	/**
+	 * @brief Return the pooled instance of the string (stays valid until the process ends).
+	 * @param str the string to intern.
+	 * @return the pooled instance of the string.
+	 */
+	static const string& intern(const string& str);
+	/**
+	 * @brief Get the statistics of the pool.
+	 * @param count the variable in which to store the number of distinct strings.
+	 * @param references the variable in which to store the number of interned strings.
+	 * @param bytes the variable in which to store the number of characters of the distinct strings.
+	 */
+	static void getStats(size_t& count, size_t& references, size_t& bytes);
+
+private:
+
+	/** the mutex for accessing the pool from several threads. */
+	static pthread_mutex_t s_mutex;
+	/** the distinct strings (never freed, as fields may be destroyed after static objects). */
+	static set<string>* s_strings;
+	/** the number of interned strings. */
+	static size_t s_references;
+	/** the number of characters of the distinct strings. */
+	static size_t s_bytes;
+
+};
+
+
+/**
+ * @brief A read-only view on the formatted input of fields with stream like accessors,
+ * so that encoding does not need to copy the input or allocate any memory.
+ * The viewed characters have to stay valid while the instance is used.
  */
-void printErrorPos(vector<string>::iterator begin, const vector<string>::iterator end, vector<string>::iterator pos);
+class StringView
+{
+public:
+
+	/**
+	 * @brief Constructs a new empty instance.
+	 */
+	StringView() : m_pos(NULL), m_end(NULL) {}
+	/**
+	 * @brief Constructs a new instance viewing a zero terminated string.
+	 * @param str the zero terminated string.
+	 */
+	StringView(const char* str) : m_pos(str), m_end(str + strlen(str)) {}
+	/**
+	 * @brief Constructs a new instance viewing a range of characters.
+	 * @param str the first character.
+	 * @param length the number of characters.
+	 */
+	StringView(const char* str, const size_t length) : m_pos(str), m_end(str + length) {}
+	/**
+	 * @brief Constructs a new instance viewing a string.
+	 * @param str the string.
+	 */
+	StringView(const string& str) : m_pos(str.data()), m_end(str.data() + str.length()) {}
+	/**
+	 * @brief Get the remaining characters.
+	 * @return the pointer to the first of the @a length() remaining characters.
+	 */
+	const char* data() const { return m_pos; }
+	/**
+	 * @brief Get the number of remaining characters.
+	 * @return the number of remaining characters.
+	 */
+	size_t length() const { return m_end - m_pos; }
+	/**
+	 * @brief Get whether all characters were consumed.
+	 * @return whether all characters were consumed.
+	 */
+	bool eof() const { return m_pos >= m_end; }
+	/**
+	 * @brief Get the next character without consuming it.
+	 * @return the next character, or -1 if all characters were consumed.
+	 */
+	int peek() const { return m_pos < m_end ? (unsigned char)*m_pos : -1; }
+	/**
+	 * @brief Consume the next character.
+	 * @return the consumed character, or -1 if all characters were consumed.
+	 */
+	int get() { return m_pos < m_end ? (unsigned char)*m_pos++ : -1; }
+	/**
+	 * @brief Consume the characters up to the next separator (like @a std::getline()).
+	 * @param token the @a StringView in which to store the characters before the separator.
+	 * @param separator the separator character (consumed as well).
+	 * @return false if all characters were already consumed, true otherwise.
+	 */
+	bool getline(StringView& token, const char separator);
+	/**
+	 * @brief Get whether the remaining characters equal the zero terminated string.
+	 * @param str the zero terminated string to compare with.
+	 * @param ignoreCase whether to ignore the case of the characters.
+	 * @return whether the remaining characters equal @a str.
+	 */
+	bool equals(const char* str, const bool ignoreCase=false) const;
+	/**
+	 * @brief Copy the remaining characters as zero terminated string to a buffer.
+	 * @param buffer the buffer to copy to.
+	 * @param size the size of @a buffer including the terminating zero.
+	 * @return false if the remaining characters do not fit into @a buffer, true otherwise.
+	 */
+	bool copy(char* buffer, const size_t size) const;
+
+private:
+
+	/** the next character. */
+	const char* m_pos;
+	/** the end of the characters. */
+	const char* m_end;
+
+};
 
 
 class DataFieldTemplates;
 class SingleDataField;
+class DecodeProgram;
+struct DecodeOp;
+struct DecodedValue;
 
 /**
  * @brief Base class for all kinds of data fields.
@@ -122,11 +274,7 @@ public:
 	 * @param comment the field comment.
 	 */
 	DataField(const string name, const string comment)
-		: m_name(name), m_comment(comment) {}
-	/**
-	 * @brief Destructor.
-	 */
-	virtual ~DataField() {}
+		: m_name(StringPool::intern(name)), m_comment(StringPool::intern(comment)), m_refCount(1) {}
 	/**
 	 * @brief Factory method for creating new instances.
 	 * @param it the iterator to traverse for the definition parts.
@@ -165,12 +313,12 @@ public:
 	 * @brief Get the field name.
 	 * @return the field name.
 	 */
-	string getName() const { return m_name; }
+	const string& getName() const { return m_name; }
 	/**
 	 * @brief Get the field comment.
 	 * @return the field comment.
 	 */
-	string getComment() const { return m_comment; }
+	const string& getComment() const { return m_comment; }
 	/**
 	 * @brief Dump the field settings to the output.
 	 * @param output the @a ostream to dump to.
@@ -194,23 +342,47 @@ public:
 			bool verbose=false, char separator=UI_FIELD_SEPARATOR) = 0;
 	/**
 	 * @brief Writes the value to the master or slave @a SymbolString.
-	 * @param input the @a istringstream to parse the formatted value from.
+	 * @param input the @a StringView to parse the formatted value from (consumed as far as parsed).
 	 * @param partType the @a PartType of the data.
 	 * @param data the unescaped data @a SymbolString for writing binary data.
 	 * @param offset the additional offset to add for writing binary data.
 	 * @param separator the separator character between multiple fields.
 	 * @return @a RESULT_OK on success, or an error code.
 	 */
-	virtual result_t write(istringstream& input,
+	virtual result_t write(StringView& input,
 			const PartType partType, SymbolString& data,
 			unsigned char offset, char separator=UI_FIELD_SEPARATOR) = 0;
+	/**
+	 * @brief Append the operations for reading this field (or contained fields) to the @a DecodeProgram.
+	 * @param program the @a DecodeProgram to append to.
+	 */
+	virtual void compile(DecodeProgram& program) = 0;
+	/**
+	 * @brief Increment the reference count for sharing this instance.
+	 * @return this instance.
+	 */
+	DataField* acquire() { __sync_add_and_fetch(&m_refCount, 1); return this; }
+	/**
+	 * @brief Decrement the reference count and delete this instance if it is no longer referenced.
+	 */
+	void release() { if (__sync_sub_and_fetch(&m_refCount, 1) == 0) delete this; }
 
 protected:
 
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~DataField() {}
+
 	/** the field name. */
-	const string m_name;
+	const string& m_name;
 	/** the field comment. */
-	const string m_comment;
+	const string& m_comment;
+
+private:
+
+	/** the number of references to this instance. */
+	unsigned int m_refCount;
 
 };
 
@@ -232,20 +404,16 @@ public:
 	 * @param length the number of symbols in the message part in which the field is stored.
 	 */
 	SingleDataField(const string name, const string comment,
-			const string unit, const dataType_t dataType, const PartType partType,
+			const string unit, const dataType_t& dataType, const PartType partType,
 			const unsigned char length)
 		: DataField(name, comment),
-		  m_unit(unit), m_dataType(dataType), m_partType(partType),
+		  m_unit(StringPool::intern(unit)), m_dataType(dataType), m_partType(partType),
 		  m_length(length) {}
-	/**
-	 * @brief Destructor.
-	 */
-	virtual ~SingleDataField() {}
 	/**
 	 * @brief Get the value unit.
 	 * @return the value unit.
 	 */
-	string getUnit() const { return m_unit; }
+	const string& getUnit() const { return m_unit; }
 	/**
 	 * @brief Get whether this field is ignored.
 	 * @return whether this field is ignored.
@@ -274,12 +442,32 @@ public:
 			ostringstream& output, bool leadingSeparator=false,
 			bool verbose=false, char separator=UI_FIELD_SEPARATOR);
 	// @copydoc
-	virtual result_t write(istringstream& input,
+	virtual result_t write(StringView& input,
 			const PartType partType, SymbolString& data,
 			unsigned char offset, char separator=UI_FIELD_SEPARATOR);
+	/**
+	 * @brief Parses the value of a bit field and merges its bits into a symbol
+	 * shared with adjacent bit fields (see @a hasFullByteOffset()).
+	 * @param input the @a StringView to parse the formatted value from.
+	 * @param symbol the symbol to merge the bits into.
+	 * @return @a RESULT_OK on success, @a RESULT_ERR_INVALID_ARG if this is no bit field, or an error code.
+	 */
+	virtual result_t writeBits(StringView& input, unsigned char& symbol) { (void)input; (void)symbol; return RESULT_ERR_INVALID_ARG; }
+	// @copydoc
+	virtual void compile(DecodeProgram& program);
 
 protected:
 
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~SingleDataField() {}
+	/**
+	 * @brief Internal method for setting the type specific parameters of a @a DecodeOp.
+	 * The default keeps @a op_field for reading via @a read().
+	 * @param op the @a DecodeOp to prepare.
+	 */
+	virtual void prepareDecodeOp(DecodeOp& op) { (void)op; }
 	/**
 	 * @brief Internal method for reading the field from a @a SymbolString.
 	 * @param input the unescaped @a SymbolString to read the binary value from.
@@ -290,19 +478,19 @@ protected:
 	virtual result_t readSymbols(SymbolString& input, const unsigned char offset, ostringstream& output) = 0;
 	/**
 	 * @brief Internal method for writing the field to a @a SymbolString.
-	 * @param input the @a istringstream to parse the formatted value from.
+	 * @param input the @a StringView to parse the formatted value from.
 	 * @param offset the offset in the @a SymbolString.
 	 * @param output the unescaped @a SymbolString to write the binary value to.
 	 * @return @a RESULT_OK on success, or an error code.
 	 */
-	virtual result_t writeSymbols(istringstream& input, const unsigned char offset, SymbolString& output) = 0;
+	virtual result_t writeSymbols(StringView& input, const unsigned char offset, SymbolString& output) = 0;
 
 protected:
 
 	/** the value unit. */
-	const string m_unit;
-	/** the data type definition. */
-	const dataType_t m_dataType;
+	const string& m_unit;
+	/** the data type definition (shared from the static table of known types). */
+	const dataType_t& m_dataType;
 	/** the message part in which the field is stored. */
 	const PartType m_partType;
 	/** the number of symbols in the message part in which the field is stored. */
@@ -328,13 +516,9 @@ public:
 	 * @param length the number of symbols in the message part in which the field is stored.
 	 */
 	StringDataField(const string name, const string comment,
-			const string unit, const dataType_t dataType, const PartType partType,
+			const string unit, const dataType_t& dataType, const PartType partType,
 			const unsigned char length)
 		: SingleDataField(name, comment, unit, dataType, partType, length) {}
-	/**
-	 * @brief Destructor.
-	 */
-	virtual ~StringDataField() {}
 	// @copydoc
 	virtual result_t derive(string name, string comment,
 			string unit, const PartType partType,
@@ -342,14 +526,59 @@ public:
 			vector<SingleDataField*>& fields);
 	// @copydoc
 	virtual void dump(ostream& output);
+	/**
+	 * @brief Reads the typed value from a @a SymbolString (date, time, or symbol span).
+	 * @param input the unescaped @a SymbolString to read the binary value from.
+	 * @param offset the offset in the @a SymbolString.
+	 * @param value the @a DecodedValue to fill.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t readValue(SymbolString& input, const unsigned char offset, DecodedValue& value);
 
 protected:
 
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~StringDataField() {}
+	// @copydoc
+	virtual void prepareDecodeOp(DecodeOp& op);
 	// @copydoc
 	virtual result_t readSymbols(SymbolString& input, const unsigned char offset, ostringstream& output);
 	// @copydoc
-	virtual result_t writeSymbols(istringstream& input, const unsigned char offset, SymbolString& output);
+	virtual result_t writeSymbols(StringView& input, const unsigned char offset, SymbolString& output);
+
+};
+
+
+/**
+ * @brief Function for reading a raw numeric value from the symbols of a field.
+ * @param symbols the first symbol of the field (with sufficient length checked by the caller).
+ * @param shift the number of bits to shift the raw value right (bit fields only).
+ * @param mask the mask to apply on the shifted raw value (bit fields only).
+ * @param replacement the replacement value (BCD only).
+ * @param value the variable in which to store the raw value.
+ * @return @a RESULT_OK on success, or an error code.
+ */
+typedef result_t (*readNumericFunc_t)(const unsigned char* symbols, const unsigned char shift,
+		const unsigned int mask, const unsigned int replacement, unsigned int& value);
+
+/**
+ * @brief Function for writing a raw numeric value to the symbols of a field.
+ * @param value the raw value to write.
+ * @param shift the number of bits to shift the raw value left (bit fields only).
+ * @param mask the mask of valid bits in the raw value (bit fields only).
+ * @param replacement the replacement value (BCD only).
+ * @param symbols the first symbol of the field (with sufficient length ensured by the caller).
+ * @return @a RESULT_OK on success, or an error code.
+ */
+typedef result_t (*writeNumericFunc_t)(unsigned int value, const unsigned char shift,
+		const unsigned int mask, const unsigned int replacement, unsigned char* symbols);
 
+/** the pair of functions specialized for reading and writing one kind of numeric field. */
+struct NumericCodec {
+	readNumericFunc_t read;   // the function for reading the raw value
+	writeNumericFunc_t write; // the function for writing the raw value
 };
 
 
@@ -372,21 +601,32 @@ public:
 	 * @param bitOffset the offset to the first bit in the binary value.
 	 */
 	NumericDataField(const string name, const string comment,
-			const string unit, const dataType_t dataType, const PartType partType,
-			const unsigned char length, const unsigned char bitCount, const unsigned char bitOffset)
-		: SingleDataField(name, comment, unit, dataType, partType, length),
-		  m_bitCount(bitCount), m_bitOffset(bitOffset) {}
-	/**
-	 * @brief Destructor.
-	 */
-	virtual ~NumericDataField() {}
+			const string unit, const dataType_t& dataType, const PartType partType,
+			const unsigned char length, const unsigned char bitCount, const unsigned char bitOffset);
 	// @copydoc
 	virtual bool hasFullByteOffset(bool after);
 	// @copydoc
 	virtual void dump(ostream& output);
+	// @copydoc
+	virtual result_t writeBits(StringView& input, unsigned char& symbol);
 
 protected:
 
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~NumericDataField() {}
+	// @copydoc
+	virtual void prepareDecodeOp(DecodeOp& op);
+	// @copydoc
+	virtual result_t writeSymbols(StringView& input, const unsigned char offset, SymbolString& output);
+	/**
+	 * @brief Internal method for parsing the raw value from the formatted input.
+	 * @param input the @a StringView to parse the formatted value from.
+	 * @param value the variable in which to store the raw value.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	virtual result_t parseRawValue(StringView& input, unsigned int& value) = 0;
 	/**
 	 * @brief Internal method for reading the raw value from a @a SymbolString.
 	 * @param input the unescaped @a SymbolString to read the binary value from.
@@ -410,6 +650,15 @@ protected:
 	/** the offset to the first bit in the binary value. */
 	const unsigned char m_bitOffset;
 
+	/** the number of bits to shift the raw value (bit fields only). */
+	const unsigned char m_shift;
+
+	/** the mask of valid bits in the shifted raw value (bit fields only). */
+	const unsigned int m_mask;
+
+	/** the @a NumericCodec specialized for the data type, length, and bits. */
+	const NumericCodec* m_codec;
+
 };
 
 
@@ -431,16 +680,12 @@ public:
 	 * @param divisor the extra divisor to apply on the value, or 1 for none.
 	 */
 	NumberDataField(const string name, const string comment,
-			const string unit, const dataType_t dataType, const PartType partType,
+			const string unit, const dataType_t& dataType, const PartType partType,
 			const unsigned char length, const unsigned char bitCount,
 			const unsigned int divisor)
 		: NumericDataField(name, comment, unit, dataType, partType, length, bitCount,
 				(dataType.maxBits < 8) ? dataType.precisionOrFirstBit : 0),
 		m_divisor(divisor) {}
-	/**
-	 * @brief Destructor.
-	 */
-	virtual ~NumberDataField() {}
 	// @copydoc
 	virtual result_t derive(string name, string comment,
 			string unit, const PartType partType,
@@ -451,10 +696,16 @@ public:
 
 protected:
 
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~NumberDataField() {}
+	// @copydoc
+	virtual void prepareDecodeOp(DecodeOp& op);
 	// @copydoc
 	virtual result_t readSymbols(SymbolString& input, const unsigned char offset, ostringstream& output);
 	// @copydoc
-	virtual result_t writeSymbols(istringstream& input, const unsigned char offset, SymbolString& output);
+	virtual result_t parseRawValue(StringView& input, unsigned int& value);
 
 private:
 
@@ -464,6 +715,91 @@ private:
 };
 
 
+/** the maximum range of values for which a @a ValueList uses a dense index. */
+#define MAX_DENSE_RANGE 256
+
+/**
+ * @brief An immutable list of value=text assignments shared between @a ValueListDataField instances
+ * with lookup by value via dense index or sorted values, and lookup by text via hash index.
+ */
+class ValueList
+{
+public:
+
+	/**
+	 * @brief Constructs a new instance with a reference count of 1.
+	 * @param values the value=text assignments.
+	 */
+	ValueList(const map<unsigned int, string>& values);
+	/**
+	 * @brief Increment the reference count.
+	 * @return this instance.
+	 */
+	ValueList* acquire() { __sync_add_and_fetch(&m_refCount, 1); return this; }
+	/**
+	 * @brief Decrement the reference count and delete this instance if it is no longer referenced.
+	 */
+	void release() { if (__sync_sub_and_fetch(&m_refCount, 1) == 0) delete this; }
+	/**
+	 * @brief Return the number of assignments.
+	 * @return the number of assignments.
+	 */
+	size_t size() const { return m_values.size(); }
+	/**
+	 * @brief Return the value of the assignment at the specified index (sorted by value).
+	 * @param index the index of the assignment.
+	 * @return the value of the assignment.
+	 */
+	unsigned int getValue(const size_t index) const { return m_values[index]; }
+	/**
+	 * @brief Return the text of the assignment at the specified index (sorted by value).
+	 * @param index the index of the assignment.
+	 * @return the text of the assignment.
+	 */
+	const string& getText(const size_t index) const { return m_texts[index]; }
+	/**
+	 * @brief Find the text assigned to a value.
+	 * @param value the value to find.
+	 * @return the assigned text, or NULL if not found.
+	 */
+	const string* find(const unsigned int value) const;
+	/**
+	 * @brief Find the value with the text (the lowest one if several have the same text).
+	 * @param text the @a StringView with the text to find.
+	 * @param value the variable in which to store the found value.
+	 * @return true if found, false otherwise.
+	 */
+	bool find(const StringView& text, unsigned int& value) const;
+
+private:
+
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	~ValueList() {}
+	/**
+	 * @brief Calculate the hash of a text.
+	 * @param text the text.
+	 * @param length the number of characters in @a text.
+	 * @return the hash.
+	 */
+	static unsigned int hash(const char* text, const size_t length);
+
+	/** the reference count. */
+	unsigned int m_refCount;
+	/** the sorted values. */
+	vector<unsigned int> m_values;
+	/** the texts assigned to the values in @a m_values. */
+	vector<string> m_texts;
+	/** the smallest value. */
+	unsigned int m_minValue;
+	/** the index+1 in @a m_values for each value from @a m_minValue, or empty if the range is too big. */
+	vector<unsigned short> m_dense;
+	/** the open addressing hash table of the texts with index+1 in @a m_texts (0 for empty). */
+	vector<unsigned int> m_hash;
+
+};
+
 /**
  * @brief A numeric data field with a list of value=text assignments and a string representation.
  */
@@ -482,16 +818,29 @@ public:
 	 * @param values the value=text assignments.
 	 */
 	ValueListDataField(const string name, const string comment,
-			const string unit, const dataType_t dataType, const PartType partType,
+			const string unit, const dataType_t& dataType, const PartType partType,
 			const unsigned char length, const unsigned char bitCount,
 			const map<unsigned int, string> values)
 		: NumericDataField(name, comment, unit, dataType, partType, length, bitCount,
 				(dataType.maxBits < 8) ? dataType.precisionOrFirstBit : 0),
-		m_values(values) {}
+		m_values(new ValueList(values)) {}
 	/**
-	 * @brief Destructor.
+	 * @brief Constructs a new instance sharing the value=text assignments.
+	 * @param name the field name.
+	 * @param comment the field comment.
+	 * @param unit the value unit.
+	 * @param dataType the data type definition.
+	 * @param partType the message part in which the field is stored.
+	 * @param length the number of symbols in the message part in which the field is stored.
+	 * @param values the shared @a ValueList (acquired by this instance).
 	 */
-	virtual ~ValueListDataField() {}
+	ValueListDataField(const string name, const string comment,
+			const string unit, const dataType_t& dataType, const PartType partType,
+			const unsigned char length, const unsigned char bitCount,
+			ValueList* values)
+		: NumericDataField(name, comment, unit, dataType, partType, length, bitCount,
+				(dataType.maxBits < 8) ? dataType.precisionOrFirstBit : 0),
+		m_values(values->acquire()) {}
 	// @copydoc
 	virtual result_t derive(string name, string comment,
 			string unit, const PartType partType, unsigned int divisor,
@@ -502,15 +851,21 @@ public:
 
 protected:
 
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~ValueListDataField() { m_values->release(); }
+	// @copydoc
+	virtual void prepareDecodeOp(DecodeOp& op);
 	// @copydoc
 	virtual result_t readSymbols(SymbolString& input, const unsigned char offset, ostringstream& output);
 	// @copydoc
-	virtual result_t writeSymbols(istringstream& input, const unsigned char offset, SymbolString& output);
+	virtual result_t parseRawValue(StringView& input, unsigned int& value);
 
 private:
 
-	/** the value=text assignments. */
-	map<unsigned int, string> m_values;
+	/** the shared value=text assignments. */
+	ValueList* m_values;
 
 };
 
@@ -537,10 +892,6 @@ public:
 			const vector<SingleDataField*> fields)
 		: DataField(name, comment),
 		  m_fields(fields) {}
-	/**
-	 * @brief Destructor.
-	 */
-	virtual ~DataFieldSet();
 	// @copydoc
 	virtual unsigned char getLength(PartType partType);
 	// @copydoc
@@ -573,9 +924,18 @@ public:
 			ostringstream& output, bool leadingSeparator=false,
 			bool verbose=false, char separator=UI_FIELD_SEPARATOR);
 	// @copydoc
-	virtual result_t write(istringstream& input,
+	virtual result_t write(StringView& input,
 			const PartType partType, SymbolString& data,
 			unsigned char offset, char separator=UI_FIELD_SEPARATOR);
+	// @copydoc
+	virtual void compile(DecodeProgram& program);
+
+protected:
+
+	/**
+	 * @brief Destructor (only via @a release()).
+	 */
+	virtual ~DataFieldSet();
 
 private:
 
@@ -585,6 +945,229 @@ private:
 };
 
 
+/** the operation codes of a @a DecodeProgram. */
+enum DecodeOpCode {
+	op_skip,   // ignored field, only the available length is checked
+	op_number, // numeric value with optional divisor
+	op_list,   // numeric value with value=text assignments
+	op_string, // string, date, or time read via @a StringDataField
+	op_field,  // any other field read via @a SingleDataField::read()
+};
+
+/** a single operation of a @a DecodeProgram with all parameters precomputed. */
+struct DecodeOp {
+	DecodeOpCode code;                      // the operation code
+	unsigned int position;                  // the position of the first symbol in the data (including header and offset)
+	unsigned char length;                   // the number of symbols
+	unsigned char offset;                   // the offset to pass to @a SingleDataField::read() for @a op_field
+	readNumericFunc_t read;                 // the specialized function for reading the raw numeric value
+	bool fused;                             // whether this bit field shares the symbol already loaded for the previous bit field
+	unsigned char shift;                    // the number of bits to shift the raw value right
+	unsigned int mask;                      // the mask to apply on the shifted raw value
+	unsigned int signBit;                   // the sign bit of a signed value, or 0 for unsigned
+	unsigned int signRange;                 // the value range to subtract from negative values (0 for 32 bits)
+	unsigned int replacement;               // the replacement value
+	unsigned int divisor;                   // the divisor to apply, or 1 for none
+	int precision;                          // the precision for formatting with divisor
+	const ValueList* values;                 // the value=text assignments for @a op_list
+	SingleDataField* field;                 // the @a SingleDataField the operation was compiled from
+};
+
+/** the maximum number of values decoded from a single message part into @a DecodedValues. */
+#define MAX_DECODED_VALUES 32
+
+/** the marker for a date or time component that is not present or has the replacement value. */
+#define DECODED_NULL 0xff
+
+/** the types of a @a DecodedValue. */
+enum DecodedType {
+	dv_null,   // replacement value
+	dv_int,    // integer without divisor in @a DecodedValue::integer
+	dv_double, // number with divisor in @a DecodedValue::number
+	dv_enum,   // value=text assignment in @a DecodedValue::assignment
+	dv_date,   // date in @a DecodedValue::date
+	dv_time,   // time in @a DecodedValue::time
+	dv_bytes,  // symbol span in @a DecodedValue::span (string, hex digits, or other field)
+};
+
+/** a decoded date. */
+struct DecodedDate {
+	unsigned char day;    // the day of month 1..31
+	unsigned char month;  // the month 1..12
+	unsigned short year;  // the year 2000..2099
+};
+
+/** a decoded time (components are @a DECODED_NULL if not present or replaced). */
+struct DecodedTime {
+	unsigned char hour;   // the hour 0..24
+	unsigned char minute; // the minute 0..59
+	unsigned char second; // the second 0..59
+};
+
+/** a decoded value=text assignment. */
+struct DecodedAssignment {
+	unsigned int value;   // the raw value
+	const string* text;   // the assigned text
+};
+
+/** a span of symbols within the decoded data. */
+struct DecodedSpan {
+	unsigned char position; // the position of the first symbol
+	unsigned char length;   // the number of symbols
+};
+
+/** a single typed value decoded by a @a DecodeProgram. */
+struct DecodedValue {
+	DecodedType type;                // the type of the value
+	const DecodeOp* op;              // the @a DecodeOp the value was decoded with
+	unsigned int raw;                // the raw binary value of numeric values
+	union {
+		long long integer;           // @a dv_int
+		double number;               // @a dv_double
+		DecodedAssignment assignment; // @a dv_enum
+		DecodedDate date;            // @a dv_date
+		DecodedTime time;            // @a dv_time
+		DecodedSpan span;            // @a dv_bytes
+	};
+};
+
+/**
+ * @brief The typed values decoded from a message part by a @a DecodeProgram,
+ * stored without allocation and formatted to text only on demand.
+ */
+class DecodedValues
+{
+	friend class DecodeProgram;
+public:
+
+	/**
+	 * @brief Constructs a new (empty) instance.
+	 */
+	DecodedValues() : m_program(NULL), m_count(0) {}
+	/**
+	 * @brief Returns the number of decoded values.
+	 * @return the number of decoded values.
+	 */
+	size_t size() const { return m_count; }
+	/**
+	 * @brief Returns the @a DecodedValue at the specified index.
+	 * @param index the index of the @a DecodedValue (less than @a size()).
+	 * @return the @a DecodedValue at the specified index.
+	 */
+	const DecodedValue& operator[](const size_t index) const { return m_values[index]; }
+	/**
+	 * @brief Returns the name of the field a value was decoded from.
+	 * @param index the index of the @a DecodedValue (less than @a size()).
+	 * @return the field name.
+	 */
+	string getName(const size_t index) const;
+	/**
+	 * @brief Format the values the same way as @a DataField::read() (without verbose).
+	 * @param output the @a ostringstream to append the formatted values to.
+	 * @param leadingSeparator whether to prepend a separator before the first formatted value.
+	 * @param separator the separator character between multiple fields.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t format(ostringstream& output, bool leadingSeparator=false, char separator=UI_FIELD_SEPARATOR);
+
+private:
+
+	/** the @a DecodeProgram the values were decoded with. */
+	const DecodeProgram* m_program;
+	/** the copy of the decoded data for formatting string values. */
+	SymbolString m_data;
+	/** the number of decoded values. */
+	size_t m_count;
+	/** the decoded values. */
+	DecodedValue m_values[MAX_DECODED_VALUES];
+
+};
+
+/**
+ * @brief A @a DataField tree compiled for reading one message part into a flat list of
+ * @a DecodeOp, so that reading needs neither virtual dispatch nor offset calculation.
+ */
+class DecodeProgram
+{
+public:
+
+	/**
+	 * @brief Constructs a new (empty) instance.
+	 */
+	DecodeProgram()
+		: m_partType(pt_any), m_headerLength(0), m_offset(0), m_previousFullByteOffset(true) {}
+	/**
+	 * @brief Compile the @a DataField for reading the specified message part.
+	 * @param field the @a DataField to compile.
+	 * @param partType the @a PartType to read (@a pt_masterData or @a pt_slaveData).
+	 * @param offset the additional offset to add for reading binary data.
+	 */
+	void compile(DataField* field, const PartType partType, const unsigned char offset);
+	/**
+	 * @brief Get the message part this program reads.
+	 * @return the @a PartType this program reads.
+	 */
+	PartType getPartType() const { return m_partType; }
+	/**
+	 * @brief Append the operation for a @a SingleDataField (only called during @a compile()).
+	 * @param field the @a SingleDataField.
+	 * @param length the number of symbols of the field.
+	 * @param fullByteBefore the result of @a SingleDataField::hasFullByteOffset() before consuming the bits.
+	 * @param fullByteAfter the result of @a SingleDataField::hasFullByteOffset() after consuming the bits.
+	 * @return the appended @a DecodeOp to be completed with type specific parameters.
+	 */
+	DecodeOp& add(SingleDataField* field, const unsigned char length,
+			const bool fullByteBefore, const bool fullByteAfter);
+	/**
+	 * @brief Returns the number of operations.
+	 * @return the number of operations.
+	 */
+	size_t size() const { return m_ops.size(); }
+	/**
+	 * @brief Reads the values from the @a SymbolString (same as @a DataField::read() without verbose).
+	 * @param data the unescaped data @a SymbolString for reading binary data.
+	 * @param output the @a ostringstream to append the formatted values to.
+	 * @param leadingSeparator whether to prepend a separator before the first formatted value.
+	 * @param separator the separator character between multiple fields.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t run(SymbolString& data, ostringstream& output,
+			bool leadingSeparator=false, char separator=UI_FIELD_SEPARATOR) const;
+	/**
+	 * @brief Decodes the typed values from the @a SymbolString without formatting them.
+	 * @param data the unescaped data @a SymbolString for reading binary data.
+	 * @param values the @a DecodedValues to fill.
+	 * @return @a RESULT_OK on success, @a RESULT_ERR_OVERFLOW if there are more than
+	 * @a MAX_DECODED_VALUES values, or another error code.
+	 */
+	result_t decode(SymbolString& data, DecodedValues& values) const;
+
+private:
+
+	/**
+	 * @brief Get whether the @a DecodeOp reads only some bits of a single symbol.
+	 * @param op the @a DecodeOp to check.
+	 * @return whether the @a DecodeOp reads a bit field.
+	 */
+	static bool isBitField(const DecodeOp& op) {
+		return (op.code == op_number || op.code == op_list) && op.length == 1
+			&& (op.shift != 0 || op.mask != 0xffffffff);
+	}
+
+	/** the message part this program reads. */
+	PartType m_partType;
+	/** the number of header symbols in front of the data of @a m_partType. */
+	unsigned char m_headerLength;
+	/** the offset of the next field during @a compile(). */
+	unsigned char m_offset;
+	/** whether the previous field used a full byte offset during @a compile(). */
+	bool m_previousFullByteOffset;
+	/** the compiled operations. */
+	vector<DecodeOp> m_ops;
+
+};
+
+
 /**
  * @brief An abstract class that support reading definitions from a file.
  */
@@ -597,7 +1180,7 @@ public:
 	 * @brief Constructs a new instance.
 	 */
 	FileReader(bool supportsDefaults)
-			: m_supportsDefaults(supportsDefaults) {}
+			: m_lineNo(0), m_supportsDefaults(supportsDefaults) {}
 	/**
 	 * @brief Destructor.
 	 */
@@ -615,12 +1198,12 @@ public:
 			return RESULT_ERR_NOTFOUND;
 
 		string line;
-		unsigned int lineNo = 0;
+		m_lineNo = 0;
 		vector<string> row;
 		string token;
 		vector< vector<string> > defaults;
 		while (getline(ifs, line) != 0) {
-			lineNo++;
+			m_lineNo++;
 			// skip empty lines and comments
 			if (line.length() == 0 || line.substr(0, 1) == "#" || line.substr(0, 2) == "//")
 				continue;
@@ -636,7 +1219,7 @@ public:
 			}
 			result_t result = addFromFile(row, arg, m_supportsDefaults == true ? &defaults : NULL);
 			if (result != RESULT_OK) {
-				cerr << "error reading \"" << filename << "\" line " << static_cast<unsigned>(lineNo) << ": " << getResultCode(result) << endl;
+				reportError(filename, m_lineNo, result);
 				ifs.close();
 				return result;
 			}
@@ -653,6 +1236,22 @@ public:
 	 */
 	virtual result_t addFromFile(vector<string>& row, T arg, vector< vector<string> >* defaults) = 0;
 
+protected:
+
+	/**
+	 * @brief Report an error while reading a file.
+	 * @param filename the name (and path) of the file.
+	 * @param lineNo the line number in which the error occurred.
+	 * @param result the error code.
+	 */
+	virtual void reportError(const string& filename, const unsigned int lineNo, const result_t result)
+	{
+		cerr << "error reading \"" << filename << "\" line " << lineNo << ": " << getResultCode(result) << endl;
+	}
+
+	/** the number of the line currently being read. */
+	unsigned int m_lineNo;
+
 private:
 	/** whether this instance supports rows with defaults (starting with a star). */
 	bool m_supportsDefaults;
@@ -670,11 +1269,11 @@ public:
 	/**
 	 * @brief Constructs a new instance.
 	 */
-	DataFieldTemplates() : FileReader(false) {}
+	DataFieldTemplates() : FileReader(false) { pthread_mutex_init(&m_mutex, NULL); }
 	/**
 	 * @brief Destructor.
 	 */
-	virtual ~DataFieldTemplates() { clear(); }
+	virtual ~DataFieldTemplates() { clear(); pthread_mutex_destroy(&m_mutex); }
 	/**
 	 * @brief Removes all @a DataField instances.
 	 */
@@ -695,11 +1294,35 @@ public:
 	 * Note: the caller may not free the returned instance.
 	 */
 	DataField* get(string name);
+	/**
+	 * @brief Derive the fields of a template for use in a message.
+	 * Fields derived without divisor and values are shared between all messages using the template.
+	 * This may be called concurrently while reading several files, but not while adding templates.
+	 * @param templ the template @a DataField returned by @a get().
+	 * @param partType the message part in which the field is stored.
+	 * @param divisor the extra divisor to apply on the value, or 0 for none (if applicable).
+	 * @param values the value=text assignments, or empty to use the template assignments (if applicable).
+	 * @param fields the @a vector to which created or shared @a SingleDataField instances are added.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t derive(DataField* templ, const PartType partType,
+			unsigned int divisor, map<unsigned int, string> values,
+			vector<SingleDataField*>& fields);
 
 private:
 
+	/**
+	 * @brief Release the shared fields derived from a template.
+	 * @param templ the template @a DataField.
+	 */
+	void releaseDerived(DataField* templ);
+
 	/** the known template @a DataField instances by name. */
 	map<string, DataField*> m_fieldsByName;
+	/** the shared fields derived from a template for a @a PartType. */
+	map<pair<DataField*, PartType>, vector<SingleDataField*> > m_derived;
+	/** mutex for accessing @a m_derived from concurrently reading files. */
+	pthread_mutex_t m_mutex;
 
 };
 
@@ -24,6 +24,9 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -32,12 +35,14 @@ Message::Message(const string clazz, const string name, const bool isSet,
 		const unsigned char srcAddress, const unsigned char dstAddress,
 		const vector<unsigned char> id, DataField* data,
 		const unsigned int pollPriority)
-		: m_class(clazz), m_name(name), m_isSet(isSet),
-		  m_isPassive(isPassive), m_comment(comment),
+		: m_class(StringPool::intern(clazz)), m_name(StringPool::intern(name)), m_isSet(isSet),
+		  m_isPassive(isPassive), m_comment(StringPool::intern(comment)),
 		  m_srcAddress(srcAddress), m_dstAddress(dstAddress),
 		  m_id(id), m_data(data), m_pollPriority(pollPriority),
-		  m_lastUpdateTime(0), m_pollCount(0), m_lastPollTime(0)
+		  m_pollCount(0), m_lastPollTime(0), m_preparedHeader(NULL),
+		  m_preparedSrc(SYN), m_preparedDst(SYN)
 {
+	pthread_mutex_init(&m_mutex, NULL);
 	int exp = 7;
 	unsigned long long key = (unsigned long long)(id.size()-2) << (8 * exp + 5);
 	if (isPassive == true)
@@ -48,20 +53,37 @@ Message::Message(const string clazz, const string name, const bool isSet,
 	for (vector<unsigned char>::const_iterator it=id.begin(); it<id.end(); it++)
 		key |= (unsigned long long)*it << (8 * exp--);
 	m_key = key;
+	m_masterProgram.compile(data, pt_masterData, (unsigned char)(id.size() - 2));
+	m_slaveProgram.compile(data, pt_slaveData, 0);
 }
 
 Message::Message(const bool isSet, const bool isPassive,
 		const unsigned char pb, const unsigned char sb,
 		DataField* data)
-		: m_class(), m_name(), m_isSet(isSet),
-		  m_isPassive(isPassive), m_comment(),
+		: m_class(StringPool::intern("")), m_name(StringPool::intern("")), m_isSet(isSet),
+		  m_isPassive(isPassive), m_comment(StringPool::intern("")),
 		  m_srcAddress(SYN), m_dstAddress(SYN),
 		  m_data(data), m_pollPriority(0),
-		  m_lastUpdateTime(0), m_pollCount(0), m_lastPollTime(0)
+		  m_pollCount(0), m_lastPollTime(0), m_preparedHeader(NULL),
+		  m_preparedSrc(SYN), m_preparedDst(SYN)
 {
+	pthread_mutex_init(&m_mutex, NULL);
 	m_id.push_back(pb);
 	m_id.push_back(sb);
 	m_key = 0;
+	m_masterProgram.compile(data, pt_masterData, 0);
+	m_slaveProgram.compile(data, pt_slaveData, 0);
+}
+
+Message::~Message()
+{
+	m_data->release();
+	for (vector<LastValue*>::iterator it = m_lastValues.begin(); it != m_lastValues.end(); it++)
+		if (*it != NULL)
+			delete *it;
+	if (m_preparedHeader != NULL)
+		delete m_preparedHeader;
+	pthread_mutex_destroy(&m_mutex);
 }
 
 /**
@@ -237,19 +259,67 @@ result_t Message::create(vector<string>::iterator& it, const vector<string>::ite
 	return RESULT_OK;
 }
 
-result_t Message::prepareMaster(const unsigned char srcAddress, SymbolString& masterData, istringstream& input, char separator, const unsigned char dstAddress)
+result_t Message::prepareMaster(const unsigned char srcAddress, SymbolString& masterData, StringView input, char separator, const unsigned char dstAddress)
 {
 	if (m_isPassive == true)
 		return RESULT_ERR_INVALID_ARG; // prepare not possible
 
+	// write the variable data behind the unused header positions
+	SymbolString master;
+	result_t result = m_data->write(input, pt_masterData, master, m_id.size() - 2, separator);
+	if (result != RESULT_OK)
+		return result;
+
+	pthread_mutex_lock(&m_mutex);
+	result = prepareHeader(srcAddress, dstAddress == SYN ? m_dstAddress : dstAddress);
+	if (result == RESULT_OK)
+		masterData = *m_preparedHeader;
+	pthread_mutex_unlock(&m_mutex);
+	if (result != RESULT_OK)
+		return result;
+
+	size_t headerLength = 5 + m_id.size() - 2;
+	if (master.size() > headerLength) {
+		// escape the data and continue the CRC
+		result = masterData.append(master.data() + headerLength, master.size() - headerLength, false, true);
+		if (result != RESULT_OK)
+			return result;
+	}
+	return masterData.push_back(masterData.getCRC(), false, false);
+}
+
+result_t Message::prepareHeader(const unsigned char srcAddress, const unsigned char dstAddress)
+{
+	if (m_preparedHeader == NULL)
+		m_preparedHeader = new SymbolString();
+	else if (m_preparedHeader->size() > 2) {
+		SymbolString& header = *m_preparedHeader;
+		if (m_preparedSrc == srcAddress && m_preparedDst == dstAddress)
+			return RESULT_OK; // unchanged addresses
+
+		if (m_preparedSrc != ESC && m_preparedSrc != SYN && m_preparedDst != ESC && m_preparedDst != SYN
+				&& srcAddress != ESC && srcAddress != SYN && dstAddress != ESC && dstAddress != SYN) {
+			// other plain addresses: keep the escaped symbols after ZZ and recalculate the CRC
+			SymbolString addresses;
+			addresses.push_back(srcAddress, false, false);
+			addresses.push_back(dstAddress, false, false);
+			SymbolString prepared;
+			prepared.assignEscaped(addresses, false);
+			result_t result = prepared.append(header.data() + 2, header.size() - 2, true, true);
+			if (result != RESULT_OK)
+				return result;
+			header = prepared;
+			m_preparedSrc = srcAddress;
+			m_preparedDst = dstAddress;
+			return RESULT_OK;
+		}
+	}
+
 	SymbolString master;
 	result_t result = master.push_back(srcAddress, false, false);
 	if (result != RESULT_OK)
 		return result;
-	if (dstAddress == SYN)
-		result = master.push_back(m_dstAddress, false, false);
-	else
-		result = master.push_back(dstAddress, false, false);
+	result = master.push_back(dstAddress, false, false);
 	if (result != RESULT_OK)
 		return result;
 	result = master.push_back(m_id[0], false, false);
@@ -259,6 +329,8 @@ result_t Message::prepareMaster(const unsigned char srcAddress, SymbolString& ma
 	if (result != RESULT_OK)
 		return result;
 	unsigned char addData = m_data->getLength(pt_masterData);
+	if (m_id.size() - 2 + addData > MAX_DATA_LENGTH)
+		return RESULT_ERR_OVERFLOW;
 	result = master.push_back(m_id.size() - 2 + addData, false, false);
 	if (result != RESULT_OK)
 		return result;
@@ -267,10 +339,13 @@ result_t Message::prepareMaster(const unsigned char srcAddress, SymbolString& ma
 		if (result != RESULT_OK)
 			return result;
 	}
-	result = m_data->write(input, pt_masterData, master, m_id.size() - 2, separator);
+	result = m_preparedHeader->assignEscaped(master, false);
 	if (result != RESULT_OK)
-		return result;
-	masterData = SymbolString(master, true);
+		m_preparedHeader->clear();
+	else {
+		m_preparedSrc = srcAddress;
+		m_preparedDst = dstAddress;
+	}
 	return result;
 }
 
@@ -281,33 +356,42 @@ result_t Message::prepareSlave(SymbolString& slaveData)
 
 	SymbolString slave;
 	unsigned char addData = m_data->getLength(pt_slaveData);
+	if (addData > MAX_DATA_LENGTH)
+		return RESULT_ERR_OVERFLOW;
 	result_t result = slave.push_back(addData, false, false);
 	if (result != RESULT_OK)
 		return result;
-	istringstream input;
+	StringView input;
 	result = m_data->write(input, pt_slaveData, slave, 0);
 	if (result != RESULT_OK)
 		return result;
-	slaveData = SymbolString(slave, true);
-	return result;
+	return slaveData.assignEscaped(slave);
 }
 
 result_t Message::decode(const PartType partType, SymbolString& data,
-		ostringstream& output, bool leadingSeparator, char separator)
+		ostringstream& output, bool leadingSeparator, char separator, const size_t bus)
 {
-	unsigned char offset;
+	int startPos = output.str().length();
+	result_t result;
+	// a single pass with the text decoder, which also yields the partial output on error
 	if (partType == pt_masterData)
-		offset = m_id.size() - 2;
+		result = m_masterProgram.run(data, output, leadingSeparator, separator);
+	else if (partType == pt_slaveData)
+		result = m_slaveProgram.run(data, output, leadingSeparator, separator);
 	else
-		offset = 0;
-	int startPos = output.str().length();
-	result_t result = m_data->read(partType, data, offset, output, leadingSeparator, false, separator);
-	time(&m_lastUpdateTime);
-	if (result != RESULT_OK) {
-		m_lastValue.clear();
+		result = m_data->read(partType, data, 0, output, leadingSeparator, false, separator);
+	pthread_mutex_lock(&m_mutex);
+	LastValue* last = getLast(bus, true);
+	time(&last->updateTime);
+	last->valid = false;
+	last->formatted = true;
+	if (result != RESULT_OK)
+		last->value.clear();
+	else
+		last->value = output.str().substr(startPos);
+	pthread_mutex_unlock(&m_mutex);
+	if (result != RESULT_OK)
 		return result;
-	}
-	m_lastValue = output.str().substr(startPos);
 	/*if (m_isPassive == false && answer == true) {
 		istringstream input; // TODO create input from database of internal variables
 		result_t result = m_data->write(input, masterData, m_id.size() - 2, slaveData, 0, separator);
@@ -317,6 +401,100 @@ result_t Message::decode(const PartType partType, SymbolString& data,
 	return RESULT_OK;
 }
 
+result_t Message::decode(const PartType partType, SymbolString& data,
+		bool leadingSeparator, char separator, const size_t bus)
+{
+	DecodeProgram* program;
+	if (partType == pt_masterData)
+		program = &m_masterProgram;
+	else if (partType == pt_slaveData)
+		program = &m_slaveProgram;
+	else
+		return RESULT_ERR_INVALID_PART;
+
+	pthread_mutex_lock(&m_mutex);
+	result_t result = decodeValues(*program, data, leadingSeparator, separator, getLast(bus, true));
+	pthread_mutex_unlock(&m_mutex);
+	return result;
+}
+
+LastValue* Message::getLast(const size_t bus, const bool create)
+{
+	if (bus >= m_lastValues.size()) {
+		if (create == false)
+			return NULL;
+		m_lastValues.resize(bus + 1, NULL);
+	}
+	LastValue* last = m_lastValues[bus];
+	if (last == NULL && create == true) {
+		last = new LastValue();
+		m_lastValues[bus] = last;
+	}
+	return last;
+}
+
+result_t Message::decodeValues(DecodeProgram& program, SymbolString& data,
+		bool leadingSeparator, char separator, LastValue* last)
+{
+	time(&last->updateTime);
+	result_t result = program.decode(data, last->values);
+	last->valid = result == RESULT_OK;
+	last->formatted = false;
+	last->leadingSeparator = leadingSeparator;
+	last->separator = separator;
+	last->value.clear();
+	return result;
+}
+
+string Message::getLastValue(const size_t bus)
+{
+	string value;
+	pthread_mutex_lock(&m_mutex);
+	LastValue* last = getLast(bus, false);
+	if (last != NULL) {
+		if (last->formatted == false) {
+			last->formatted = true;
+			if (last->valid == true) {
+				ostringstream output;
+				if (last->values.format(output, last->leadingSeparator, last->separator) == RESULT_OK)
+					last->value = output.str();
+			}
+		}
+		value = last->value;
+	}
+	pthread_mutex_unlock(&m_mutex);
+	return value;
+}
+
+bool Message::hasLastValues(const size_t bus)
+{
+	pthread_mutex_lock(&m_mutex);
+	LastValue* last = getLast(bus, false);
+	bool result = last != NULL && last->valid == true && last->values.size() > 0;
+	pthread_mutex_unlock(&m_mutex);
+	return result;
+}
+
+bool Message::getLastValues(DecodedValues& values, const size_t bus)
+{
+	pthread_mutex_lock(&m_mutex);
+	LastValue* last = getLast(bus, false);
+	bool valid = last != NULL && last->valid;
+	if (valid == true)
+		values = last->values;
+	pthread_mutex_unlock(&m_mutex);
+	return valid;
+}
+
+time_t Message::getLastUpdateTime(const size_t bus)
+{
+	pthread_mutex_lock(&m_mutex);
+	LastValue* last = getLast(bus, false);
+	time_t updateTime = last == NULL ? 0 : last->updateTime;
+	pthread_mutex_unlock(&m_mutex);
+	return updateTime;
+}
+
 bool Message::isLessPollWeight(Message* other) {
 	if (m_pollPriority * m_pollCount < other->m_pollPriority * other->m_pollCount)
 		return true;
@@ -354,14 +532,21 @@ result_t MessageMap::add(Message* message)
 	key = string(isPassive ? "-P" : (isSet ? "-W" : "-R")) + name; // also store without class
 	m_messagesByName[key] = message; // last key without class overrides previous
 
-	if (message->isPassive() == true) {
-		unsigned char idLength = message->getId().size() - 2;
+	unsigned char idLength = message->getId().size() - 2;
+	if (isPassive == true) {
 		if (idLength < m_minIdLength)
 			m_minIdLength = idLength;
 		if (idLength > m_maxIdLength)
 			m_maxIdLength = idLength;
 		m_passiveMessagesByKey[pkey] = message;
 	}
+	else if (m_activeMessagesByKey.find(pkey) == m_activeMessagesByKey.end()) {
+		if (idLength < m_minActiveIdLength)
+			m_minActiveIdLength = idLength;
+		if (idLength > m_maxActiveIdLength)
+			m_maxActiveIdLength = idLength;
+		m_activeMessagesByKey[pkey] = message;
+	}
 
 	if (message->getPollPriority() > 0)
 		m_pollMessages.push(message);
@@ -395,6 +580,35 @@ result_t MessageMap::addFromFile(vector<string>& row, DataFieldTemplates* arg, v
 	return result;
 }
 
+result_t MessageMap::merge(MessageList& list)
+{
+	size_t count = list.m_messages.size();
+	for (size_t index = 0; index < count; index++) {
+		unsigned int lineNo = list.m_messages[index].first;
+		Message* message = list.m_messages[index].second;
+		list.m_messages[index].second = NULL;
+		result_t result = add(message);
+		if (result != RESULT_OK)
+			delete message;
+
+		// only the last type of a row determines its result, unless creating a further type failed
+		bool lastOfRow = index+1 < count ? list.m_messages[index+1].first != lineNo : lineNo != list.m_errorLineNo;
+		if (lastOfRow == true && result != RESULT_OK) {
+			reportError(list.getFilename(), lineNo, result);
+			list.clear();
+			return result;
+		}
+	}
+	list.clear();
+
+	if (list.m_result != RESULT_OK) {
+		cout << list.m_errorPos.str();
+		if (list.m_errorLineNo > 0)
+			reportError(list.getFilename(), list.m_errorLineNo, list.m_result);
+	}
+	return list.m_result;
+}
+
 Message* MessageMap::find(const string& clazz, const string& name, const bool isSet, const bool isPassive)
 {
 	for (int i=0; i<2; i++) {
@@ -411,29 +625,43 @@ Message* MessageMap::find(const string& clazz, const string& name, const bool is
 	return NULL;
 }
 
-Message* MessageMap::find(SymbolString& master)
+Message* MessageMap::find(SymbolString& master, const bool active)
 {
 	if (master.size() < 5)
 		return NULL;
+	unsigned char minIdLength = active == true ? m_minActiveIdLength : m_minIdLength;
 	unsigned char maxIdLength = master[4];
-	if (maxIdLength < m_minIdLength)
+	if (maxIdLength < minIdLength)
 		return NULL;
-	if (maxIdLength > m_maxIdLength)
+	if (active == true && maxIdLength > m_maxActiveIdLength)
+		maxIdLength = m_maxActiveIdLength;
+	else if (active == false && maxIdLength > m_maxIdLength)
 		maxIdLength = m_maxIdLength;
 	if (master.size() < 5+maxIdLength)
 		return NULL;
 
 	unsigned long long sourceMask = 0x1fLL << (8 * 7);
-	for (int idLength = maxIdLength; idLength >= m_minIdLength; idLength--) {
+	for (int idLength = maxIdLength; idLength >= minIdLength; idLength--) {
 		int exp = 7;
 		unsigned long long key = (unsigned long long)idLength << (8 * exp + 5);
-		key |= (unsigned long long)getMasterNumber(master[0]) << (8 * exp--);
+		if (active == true)
+			key |= sourceMask; // special value for active
+		else
+			key |= (unsigned long long)getMasterNumber(master[0]) << (8 * exp);
+		exp--;
 		key |= (unsigned long long)master[1] << (8 * exp--);
 		key |= (unsigned long long)master[2] << (8 * exp--);
 		key |= (unsigned long long)master[3] << (8 * exp--);
 		for (unsigned char i=0; i<idLength; i++)
 			key |= (unsigned long long)master[5 + i] << (8 * exp--);
 
+		if (active == true) {
+			map<unsigned long long , Message*>::iterator it = m_activeMessagesByKey.find(key);
+			if (it != m_activeMessagesByKey.end())
+				return it->second;
+			continue;
+		}
+
 		map<unsigned long long , Message*>::iterator it = m_passiveMessagesByKey.find(key);
 		if (it != m_passiveMessagesByKey.end())
 			return it->second;
@@ -467,8 +695,11 @@ void MessageMap::clear()
 	m_messagesByName.clear();
 	// clear messages by key
 	m_passiveMessagesByKey.clear();
+	m_activeMessagesByKey.clear();
 	m_minIdLength = 4;
 	m_maxIdLength = 0;
+	m_minActiveIdLength = 4;
+	m_maxActiveIdLength = 0;
 }
 
 Message* MessageMap::getNextPoll()
@@ -482,3 +713,120 @@ Message* MessageMap::getNextPoll()
 	m_pollMessages.push(ret); // re-insert at new position
 	return ret;
 }
+
+
+result_t MessageList::read(DataFieldTemplates* templates)
+{
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	m_result = readFromFile(m_filename, templates);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	m_duration = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+	return m_result;
+}
+
+result_t MessageList::addFromFile(vector<string>& row, DataFieldTemplates* arg, vector< vector<string> >* defaults)
+{
+	Message* message = NULL;
+	string types = row[0];
+	if (types.length() == 0)
+		types.append("r");
+	result_t result = RESULT_ERR_EOF;
+
+	istringstream stream(types);
+	string type;
+	while (getline(stream, type, VALUE_SEPARATOR) != 0) {
+		row[0] = type;
+		vector<string>::iterator it = row.begin();
+		result = Message::create(it, row.end(), defaults, arg, message);
+		if (result != RESULT_OK) {
+			printErrorPos(row.begin(), row.end(), it, m_errorPos);
+			return result;
+		}
+		m_messages.push_back(make_pair(m_lineNo, message));
+	}
+	return RESULT_OK;
+}
+
+result_t MessageList::collect(const string path, const string extension, vector<MessageList*>& lists)
+{
+	DIR* dir = opendir(path.c_str());
+
+	if (dir == NULL)
+		return RESULT_ERR_NOTFOUND;
+
+	dirent* d = readdir(dir);
+
+	while (d != NULL) {
+		if (d->d_type == DT_DIR) {
+			string fn = d->d_name;
+
+			if (fn != "." && fn != "..") {
+				const string p = path + "/" + d->d_name;
+				result_t result = collect(p, extension, lists);
+				if (result != RESULT_OK) {
+					closedir(dir);
+					return result;
+				}
+			}
+		} else if (d->d_type == DT_REG) {
+			string fn = d->d_name;
+
+			if (fn.find(extension, (fn.length() - extension.length())) != string::npos
+				&& fn != "_types" + extension) {
+				const string p = path + "/" + d->d_name;
+				lists.push_back(new MessageList(p));
+			}
+		}
+
+		d = readdir(dir);
+	}
+	closedir(dir);
+
+	return RESULT_OK;
+}
+
+size_t MessageList::readAll(vector<MessageList*>& lists, DataFieldTemplates* templates)
+{
+	WQueue<MessageList*> queue;
+	for (vector<MessageList*>::iterator it = lists.begin(); it != lists.end(); it++)
+		queue.add(*it);
+
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = processors > 1 ? (size_t)processors : 1;
+	if (threads > lists.size())
+		threads = lists.size();
+	vector<MessageListReader*> readers;
+	for (size_t index = 0; index < threads; index++) {
+		MessageListReader* reader = new MessageListReader(&queue, templates);
+		if (reader->start("configreader") == false)
+			reader->run(); // read the remaining files right here
+		readers.push_back(reader);
+	}
+	for (vector<MessageListReader*>::iterator it = readers.begin(); it != readers.end(); it++) {
+		(*it)->join();
+		delete *it;
+	}
+	return threads;
+}
+
+void MessageList::clear()
+{
+	for (vector<pair<unsigned int, Message*> >::iterator it = m_messages.begin(); it != m_messages.end(); it++)
+		if (it->second != NULL)
+			delete it->second;
+	m_messages.clear();
+}
+
+void MessageList::reportError(const string&, const unsigned int lineNo, const result_t)
+{
+	m_errorLineNo = lineNo; // reported later on by MessageMap::merge()
+}
+
+
+void MessageListReader::run()
+{
+	MessageList* list;
+	while ((list = m_queue->remove(false)) != NULL)
+		list->read(m_templates);
+}
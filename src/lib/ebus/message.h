@@ -23,13 +23,45 @@
 #include "data.h"
 #include "result.h"
 #include "symbol.h"
+#include "thread.h"
+#include "wqueue.h"
 #include <string>
 #include <vector>
 #include <map>
+#include <pthread.h>
 
 using namespace std;
 
 class MessageMap;
+class MessageList;
+
+/**
+ * @brief The last decoded value of a @a Message on a single bus.
+ */
+struct LastValue
+{
+	/**
+	 * @brief Construct a new instance without a decoded value.
+	 */
+	LastValue()
+		: valid(false), formatted(true), leadingSeparator(false),
+		  separator(UI_FIELD_SEPARATOR), updateTime(0) {}
+
+	/** the last decoded typed values, only valid if @a valid. */
+	DecodedValues values;
+	/** whether the last decoding was successful. */
+	bool valid;
+	/** whether @a value is already formatted from @a values. */
+	bool formatted;
+	/** whether to prepend a separator when formatting @a value. */
+	bool leadingSeparator;
+	/** the separator character for formatting @a value. */
+	char separator;
+	/** the last decoded value. */
+	string value;
+	/** the system time when @a value was updated, 0 for never. */
+	time_t updateTime;
+};
 
 /**
  * @brief Defines parameters of a message sent or received on the bus.
@@ -73,7 +105,7 @@ public:
 	/**
 	 * @brief Destructor.
 	 */
-	virtual ~Message() { delete m_data; }
+	virtual ~Message();
 	/**
 	 * @brief Factory method for creating a new instance.
 	 * @param it the iterator to traverse for the definition parts.
@@ -91,12 +123,12 @@ public:
 	 * @brief Get the optional device class.
 	 * @return the optional device class.
 	 */
-	string getClass() const { return m_class; }
+	const string& getClass() const { return m_class; }
 	/**
 	 * @brief Get the message name (unique within the same class and type).
 	 * @return the message name (unique within the same class and type).
 	 */
-	string getName() const { return m_name; }
+	const string& getName() const { return m_name; }
 	/**
 	 * @brief Get whether this is a set message.
 	 * @return whether this is a set message.
@@ -112,7 +144,7 @@ public:
 	 * @brief Get the comment.
 	 * @return the comment.
 	 */
-	string getComment() const { return m_comment; }
+	const string& getComment() const { return m_comment; }
 	/**
 	 * @brief Get the source address.
 	 * @return the source address, or @a SYN for any.
@@ -139,17 +171,24 @@ public:
 	 */
 	unsigned char getPollPriority() const { return m_pollPriority; }
 
+	/**
+	 * @brief Get the number of data symbols of the specified part (excluding further ID bytes).
+	 * @param partType the @a PartType of the data.
+	 * @return the number of data symbols.
+	 */
+	unsigned char getLength(const PartType partType) { return m_data->getLength(partType); }
+
 	/**
 	 * @brief Prepare the master @a SymbolString for sending a query or command to the bus.
 	 * @param srcAddress the source address to set.
-	 * @param masterData the master data @a SymbolString for writing symbols to.
-	 * @param input the @a istringstream to parse the formatted value(s) from.
+	 * @param masterData the master data @a SymbolString for writing the escaped symbols including the CRC to.
+	 * @param input the @a StringView to parse the formatted value(s) from (without any copy).
 	 * @param separator the separator character between multiple fields.
 	 * @param dstAddress the destination address to set, or @a SYN to keep the address defined during construction.
 	 * @return @a RESULT_OK on success, or an error code.
 	 */
 	result_t prepareMaster(const unsigned char srcAddress, SymbolString& masterData,
-			istringstream& input, char separator=UI_FIELD_SEPARATOR,
+			StringView input=StringView(), char separator=UI_FIELD_SEPARATOR,
 			const unsigned char dstAddress=SYN);
 
 	/**
@@ -166,22 +205,55 @@ public:
 	 * @param output the @a ostringstream to append the formatted value to.
 	 * @param leadingSeparator whether to prepend a separator before the formatted value.
 	 * @param separator the separator character between multiple fields.
+	 * @param bus the index of the bus the data was received on.
 	 * @return @a RESULT_OK on success, or an error code.
 	 */
 	result_t decode(const PartType partType, SymbolString& data,
-			ostringstream& output, bool leadingSeparator=false, char separator=UI_FIELD_SEPARATOR);
+			ostringstream& output, bool leadingSeparator=false, char separator=UI_FIELD_SEPARATOR,
+			const size_t bus=0);
+
+	/**
+	 * @brief Decode a received message into typed values only, the text for
+	 * @a getLastValue() is formatted on demand.
+	 * @param partType the @a PartType of the data (master or slave).
+	 * @param data the unescaped data @a SymbolString for reading binary data.
+	 * @param leadingSeparator whether to prepend a separator before the formatted value.
+	 * @param separator the separator character between multiple fields.
+	 * @param bus the index of the bus the data was received on.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t decode(const PartType partType, SymbolString& data,
+			bool leadingSeparator=false, char separator=UI_FIELD_SEPARATOR,
+			const size_t bus=0);
 
 	/**
 	 * @brief Get the last decoded value.
+	 * @param bus the index of the bus to get the value for.
 	 * @return the last decoded value, or the empty string if it was not successful.
 	 */
-	string getLastValue() { return m_lastValue; }
+	string getLastValue(const size_t bus=0);
+
+	/**
+	 * @brief Return whether the last decoding was successful and resulted in at least one value.
+	 * @param bus the index of the bus to check.
+	 * @return whether the last decoding was successful and resulted in at least one value.
+	 */
+	bool hasLastValues(const size_t bus=0);
 
 	/**
-	 * @brief Get the time when @a m_lastValue was updated.
-	 * @return the time when @a m_lastValue was updated, or 0 if this message was not decoded yet.
+	 * @brief Get the last decoded typed values.
+	 * @param values the @a DecodedValues to copy the last decoded values to.
+	 * @param bus the index of the bus to get the values for.
+	 * @return true if the last decoding was successful, false otherwise.
 	 */
-	time_t getLastUpdateTime() { return m_lastUpdateTime; }
+	bool getLastValues(DecodedValues& values, const size_t bus=0);
+
+	/**
+	 * @brief Get the time when the last value was updated.
+	 * @param bus the index of the bus to get the time for.
+	 * @return the time when the last value was updated, or 0 if this message was not decoded yet.
+	 */
+	time_t getLastUpdateTime(const size_t bus=0);
 
 	/**
 	 * @brief Get the time when this message was last polled for.
@@ -198,17 +270,46 @@ public:
 
 private:
 
+	/**
+	 * @brief Get the @a LastValue of a bus (@a m_mutex has to be locked).
+	 * @param bus the index of the bus.
+	 * @param create whether to allocate the @a LastValue if not done yet.
+	 * @return the @a LastValue of the bus, or NULL if not allocated yet and @a create is false.
+	 */
+	LastValue* getLast(const size_t bus, const bool create);
+
+	/**
+	 * @brief Decode a received message into a @a LastValue (@a m_mutex has to be locked).
+	 * @param program the @a DecodeProgram for the part.
+	 * @param data the unescaped data @a SymbolString for reading binary data.
+	 * @param leadingSeparator whether to prepend a separator before the formatted value.
+	 * @param separator the separator character between multiple fields.
+	 * @param last the @a LastValue to decode into.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t decodeValues(DecodeProgram& program, SymbolString& data,
+			bool leadingSeparator, char separator, LastValue* last);
+
+	/**
+	 * @brief Prepare the escaped master header in @a m_preparedHeader for the addresses
+	 * (@a m_mutex has to be locked).
+	 * @param srcAddress the source address (QQ).
+	 * @param dstAddress the destination address (ZZ).
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t prepareHeader(const unsigned char srcAddress, const unsigned char dstAddress);
+
 	 /** the optional device class. */
-	const string m_class;
+	const string& m_class;
 	/** the message name (unique within the same class and type). */
-	const string m_name;
+	const string& m_name;
 	/** whether this is a set message. */
 	const bool m_isSet;
 	/** true if message can only be initiated by a participant other than us,
 	 * false if message can be initiated by any participant. */
 	const bool m_isPassive;
 	/** the comment. */
-	const string m_comment;
+	const string& m_comment;
 	/** the source address, or @a SYN for any (only relevant if passive). */
 	const unsigned char m_srcAddress;
 	/** the destination address. */
@@ -219,17 +320,29 @@ private:
 	unsigned long long m_key;
 	/** the @a DataField for encoding/decoding the message. */
 	DataField* m_data;
+	/** the @a DecodeProgram compiled from @a m_data for decoding the master data. */
+	DecodeProgram m_masterProgram;
+	/** the @a DecodeProgram compiled from @a m_data for decoding the slave data. */
+	DecodeProgram m_slaveProgram;
 	/** the priority for polling, or 0 for no polling at all. */
 	const unsigned char m_pollPriority;
-	/** the last decoded value. */
-	string m_lastValue;
-	/** the system time when @a m_lastValue was updated, 0 for never. */
-	time_t m_lastUpdateTime;
+	/** the mutex for @a m_lastValues, as the @a Message may be decoded by several bus threads. */
+	pthread_mutex_t m_mutex;
+	/** the @a LastValue by bus index (each allocated on first decoding on that bus). */
+	vector<LastValue*> m_lastValues;
 	/** the number of times this messages was already polled for. */
 	unsigned int m_pollCount;
 	/** the system time when this message was last polled for, 0 for never. */
 	time_t m_lastPollTime;
 
+	/** the escaped master header QQ ZZ PB SB NN and the fixed ID bytes with the CRC calculated
+	 * up to there for the last used addresses (allocated on first preparation), or NULL. */
+	SymbolString* m_preparedHeader;
+	/** the unescaped source address (QQ) @a m_preparedHeader was prepared for. */
+	unsigned char m_preparedSrc;
+	/** the unescaped destination address (ZZ) @a m_preparedHeader was prepared for. */
+	unsigned char m_preparedDst;
+
 };
 
 
@@ -251,7 +364,8 @@ public:
 	/**
 	 * @brief Construct a new instance.
 	 */
-	MessageMap() : FileReader(true), m_minIdLength(4), m_maxIdLength(0), m_messageCount(0) {}
+	MessageMap() : FileReader(true), m_minIdLength(4), m_maxIdLength(0),
+		m_minActiveIdLength(4), m_maxActiveIdLength(0), m_messageCount(0) {}
 	/**
 	 * @brief Destructor.
 	 */
@@ -265,6 +379,13 @@ public:
 	result_t add(Message* message);
 	// @copydoc
 	virtual result_t addFromFile(vector<string>& row, DataFieldTemplates* arg,  vector< vector<string> >* defaults);
+	/**
+	 * @brief Add the @a Message instances of a @a MessageList read before, exactly as if the file was read directly.
+	 * Errors are reported with the file name and line number, and the remaining instances are discarded.
+	 * @param list the @a MessageList to take the @a Message instances from.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t merge(MessageList& list);
 	/**
 	 * @brief Find the @a Message instance for the specified class and name.
 	 * @param class the optional device class.
@@ -278,10 +399,11 @@ public:
 	/**
 	 * @brief Find the @a Message instance for the specified master data.
 	 * @param master the master @a SymbolString for identifying the @a Message.
+	 * @param active true to find an active @a Message (i.e. as if sent by us), false to find a passive one.
 	 * @return the @a Message instance, or NULL.
 	 * Note: the caller may not free the returned instance.
 	 */
-	Message* find(SymbolString& master);
+	Message* find(SymbolString& master, const bool active=false);
 	/**
 	 * @brief Removes all @a Message instances.
 	 */
@@ -306,12 +428,18 @@ public:
 
 private:
 
-	/** the minimum ID length used by any of the known @a Message instances. */
+	/** the minimum ID length used by any of the known passive @a Message instances. */
 	unsigned char m_minIdLength;
 
-	/** the maximum ID length used by any of the known @a Message instances. */
+	/** the maximum ID length used by any of the known passive @a Message instances. */
 	unsigned char m_maxIdLength;
 
+	/** the minimum ID length used by any of the known active @a Message instances. */
+	unsigned char m_minActiveIdLength;
+
+	/** the maximum ID length used by any of the known active @a Message instances. */
+	unsigned char m_maxActiveIdLength;
+
 	/** the number of distinct @a Message instances stored in @a m_messagesByName. */
 	int m_messageCount;
 
@@ -321,9 +449,133 @@ private:
 	/** the known passive @a Message instances by key. */
 	map<unsigned long long, Message*> m_passiveMessagesByKey;
 
+	/** the known active @a Message instances by key (first one wins for read and write with the same key). */
+	map<unsigned long long, Message*> m_activeMessagesByKey;
+
 	/** the known @a Message instances to poll, by priority. */
 	priority_queue<Message*, vector<Message*>, compareMessagePriority> m_pollMessages;
 
 };
 
+
+/**
+ * @brief Holds the @a Message instances read from a single file for merging them into a @a MessageMap later on.
+ * Several instances may be read concurrently as long as the @a DataFieldTemplates are not modified.
+ */
+class MessageList : public FileReader<DataFieldTemplates*>
+{
+	friend class MessageMap;
+public:
+
+	/**
+	 * @brief Construct a new instance.
+	 * @param filename the name (and path) of the file to read.
+	 */
+	MessageList(const string filename)
+		: FileReader(true), m_filename(filename), m_result(RESULT_OK), m_errorLineNo(0), m_duration(0) {}
+	/**
+	 * @brief Destructor.
+	 */
+	virtual ~MessageList() { clear(); }
+	/**
+	 * @brief Read the @a Message instances from the file and measure the time taken.
+	 * @param templates the @a DataFieldTemplates to be referenced by name.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	result_t read(DataFieldTemplates* templates);
+	// @copydoc
+	virtual result_t addFromFile(vector<string>& row, DataFieldTemplates* arg,  vector< vector<string> >* defaults);
+	/**
+	 * @brief Removes all @a Message instances not yet merged.
+	 */
+	void clear();
+	/**
+	 * @brief Get the name (and path) of the file.
+	 * @return the name (and path) of the file.
+	 */
+	const string& getFilename() const { return m_filename; }
+	/**
+	 * @brief Get the number of @a Message instances read.
+	 * @return the number of @a Message instances read.
+	 */
+	size_t size() const { return m_messages.size(); }
+	/**
+	 * @brief Get the time taken by @a read().
+	 * @return the time taken by @a read() in microseconds.
+	 */
+	unsigned long getDuration() const { return m_duration; }
+
+	/**
+	 * @brief Collect the files from the specified path and its subdirectories in the order to merge them.
+	 * @param path the path from which to collect the files.
+	 * @param extension the filename extension of the files to collect (except for "_types" files).
+	 * @param lists the @a vector to which a new @a MessageList is added for each file.
+	 * @return @a RESULT_OK on success, or an error code.
+	 */
+	static result_t collect(const string path, const string extension, vector<MessageList*>& lists);
+
+	/**
+	 * @brief Read the collected @a MessageList instances concurrently with one thread per processor.
+	 * @param lists the @a MessageList instances to read.
+	 * @param templates the @a DataFieldTemplates to be referenced by name.
+	 * @return the number of threads used.
+	 */
+	static size_t readAll(vector<MessageList*>& lists, DataFieldTemplates* templates);
+
+protected:
+
+	// @copydoc
+	virtual void reportError(const string& filename, const unsigned int lineNo, const result_t result);
+
+private:
+
+	/** the name (and path) of the file. */
+	const string m_filename;
+
+	/** the line number and @a Message instance for each message type in the order read. */
+	vector<pair<unsigned int, Message*> > m_messages;
+
+	/** the result of @a read(). */
+	result_t m_result;
+
+	/** the line number of the erroneous row, or 0. */
+	unsigned int m_errorLineNo;
+
+	/** the error position of the erroneous row as printed by @a printErrorPos(). */
+	ostringstream m_errorPos;
+
+	/** the time taken by @a read() in microseconds. */
+	unsigned long m_duration;
+
+};
+
+
+/**
+ * @brief Thread for reading @a MessageList instances concurrently.
+ */
+class MessageListReader : public Thread
+{
+
+public:
+	/**
+	 * @brief Construct a new instance.
+	 * @param queue the queue of @a MessageList instances to read until it is empty.
+	 * @param templates the @a DataFieldTemplates to be referenced by name.
+	 */
+	MessageListReader(WQueue<MessageList*>* queue, DataFieldTemplates* templates)
+		: m_queue(queue), m_templates(templates) {}
+
+	// @copydoc
+	virtual void run();
+
+private:
+
+	/** the queue of @a MessageList instances to read. */
+	WQueue<MessageList*>* m_queue;
+
+	/** the @a DataFieldTemplates to be referenced by name. */
+	DataFieldTemplates* m_templates;
+
+};
+
 #endif // LIBEBUS_MESSAGE_H_
@@ -25,53 +25,136 @@
 #include "result.h"
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <fcntl.h>
 #include <fstream>
 #include <sys/ioctl.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#ifdef HAVE_PPOLL
 #include <poll.h>
-#endif
 
 using namespace std;
 
+result_t Device::open(const string deviceName, const bool noDeviceCheck)
+{
+	close();
+	result_t result = openDevice(deviceName, noDeviceCheck);
+
+	pthread_mutex_lock(&m_mutex);
+	if (result == RESULT_OK)
+		m_open = true;
+	else
+		closeDevice(); // release a partially opened device
+	pthread_mutex_unlock(&m_mutex);
+
+	return result;
+}
+
+void Device::close()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_open = false;
+	closeDevice();
+	pthread_mutex_unlock(&m_mutex);
+}
+
 bool Device::isOpen()
 {
-	if (isValid() == false)
-		m_open = false;
+	if (m_open == true && m_noDeviceCheck == false && m_recvCount == 0) {
+		// hangups are detected during I/O, so probe only rarely while idle
+		unsigned long long now = getMonotonicTime();
+		if (now - m_lastCheck >= DEVICE_CHECK_INTERVAL) {
+			m_lastCheck = now;
+			if (isValid() == false)
+				close();
+		}
+	}
 
 	return m_open;
 }
 
 bool Device::isValid()
 {
-	if (m_noDeviceCheck == false) {
-		int port;
+	int port;
 
-		if (ioctl(m_fd, TIOCMGET, &port) == -1) {
-			closeDevice();
-			m_open = false;
-			return false;
-		}
+	return ioctl(m_fd, TIOCMGET, &port) != -1;
+}
+
+bool Device::isHangup(const int error)
+{
+	switch (error) {
+	case 0:
+	case EIO:
+	case ENXIO:
+	case ENODEV:
+	case EBADF:
+	case EPIPE:
+	case ECONNRESET:
+		return true;
+	default:
+		return false;
 	}
+}
+
+bool Device::checkHangup(const int error)
+{
+	if (isHangup(error) == false)
+		return false;
 
+	close();
 	return true;
 }
 
+ssize_t Device::send(const unsigned char* buffer, size_t nbytes)
+{
+	pthread_mutex_lock(&m_mutex);
+	ssize_t ret = m_open == true ? sendBytes(buffer, nbytes) : RESULT_ERR_DEVICE;
+	pthread_mutex_unlock(&m_mutex);
+
+	return ret;
+}
+
 ssize_t Device::sendBytes(const unsigned char* buffer, size_t nbytes)
 {
-	if (isValid() == false)
+	// write bytes to device
+	ssize_t ret = write(m_fd, buffer, nbytes);
+	if (ret < 0 && isHangup(errno) == true)
 		return RESULT_ERR_DEVICE;
 
-	// write bytes to device
-	return write(m_fd, buffer, nbytes);
+	return ret;
 }
 
 ssize_t Device::recvBytes(const long timeout, size_t maxCount, unsigned char* buffer)
 {
-	if (isValid() == false)
+	if (m_recvCount == 0) {
+		result_t result = fillRecvBuffer(timeout);
+		if (result != RESULT_OK)
+			return result;
+	}
+
+	if (maxCount > m_recvCount)
+		maxCount = m_recvCount;
+
+	if (buffer != NULL) {
+		// fetch bytes directly into provided buffer
+		memcpy(buffer, m_recvBuffer + m_recvPos, maxCount);
+		m_recvPos += maxCount;
+		m_recvCount -= maxCount;
+	}
+
+	return maxCount;
+}
+
+result_t Device::fillRecvBuffer(const long timeout)
+{
+	if (m_open == false)
 		return RESULT_ERR_DEVICE;
 
 	if (timeout > 0) {
@@ -79,8 +162,8 @@ ssize_t Device::recvBytes(const long timeout, size_t maxCount, unsigned char* bu
 		struct timespec tdiff;
 
 		// set select timeout
-		tdiff.tv_sec = 0;
-		tdiff.tv_nsec = timeout*1000;
+		tdiff.tv_sec = timeout/1000000;
+		tdiff.tv_nsec = (timeout%1000000)*1000;
 
 #ifdef HAVE_PPOLL
 		int nfds = 1;
@@ -92,6 +175,11 @@ ssize_t Device::recvBytes(const long timeout, size_t maxCount, unsigned char* bu
 		fds[0].events = POLLIN;
 
 		ret = ppoll(fds, nfds, &tdiff, NULL);
+		if (ret > 0 && (fds[0].revents & POLLIN) == 0
+		&& (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0) {
+			checkHangup(0); // e.g. USB adapter removed
+			return RESULT_ERR_DEVICE;
+		}
 #else
 #ifdef HAVE_PSELECT
 		fd_set readfds;
@@ -106,38 +194,26 @@ ssize_t Device::recvBytes(const long timeout, size_t maxCount, unsigned char* bu
 		if (ret == 0) return RESULT_ERR_TIMEOUT;
 	}
 
-	if (buffer != NULL) {
-		// read bytes from device directly into provided buffer
-		ssize_t nbytes = read(m_fd, buffer, maxCount);
-		if (nbytes == 0)
-			return RESULT_ERR_EOF;
-
-		return nbytes;
-	}
-
-	if (maxCount > sizeof(m_buffer))
-		maxCount = sizeof(m_buffer);
-
-	// read bytes from device into temporary buffer
-	ssize_t nbytes = read(m_fd, m_buffer, maxCount);
-	if (nbytes == 0)
+	// read all available bytes from device at once
+	ssize_t nbytes = read(m_fd, m_recvBuffer, sizeof(m_recvBuffer));
+	if (nbytes == 0) {
+		checkHangup(0); // hangup or connection closed by peer
 		return RESULT_ERR_EOF;
+	}
+	if (nbytes < 0)
+		return checkHangup(errno) == true ? RESULT_ERR_DEVICE : RESULT_ERR_GENERIC_IO;
 
-	for (int i = 0; i < nbytes; i++)
-		m_recvBuffer.push(m_buffer[i]);
-
-	return nbytes;
+	m_recvTime = getMonotonicTime();
+	m_recvPos = 0;
+	m_recvCount = nbytes;
+	return RESULT_OK;
 }
 
 unsigned char Device::getByte()
 {
-	unsigned char byte;
-
-	if (m_recvBuffer.empty() == false) {
-		byte = m_recvBuffer.front();
-		m_recvBuffer.pop();
-
-		return byte;
+	if (m_recvCount > 0) {
+		m_recvCount--;
+		return m_recvBuffer[m_recvPos++];
 	}
 
 	return 0;
@@ -148,10 +224,10 @@ result_t DeviceSerial::openDevice(const string deviceName, const bool noDeviceCh
 {
 	m_noDeviceCheck = noDeviceCheck;
 	struct termios newSettings;
-	m_open = false;
+	clearRecvBuffer();
 
 	// open file descriptor
-	m_fd = open(deviceName.c_str(), O_RDWR | O_NOCTTY);
+	m_fd = ::open(deviceName.c_str(), O_RDWR | O_NOCTTY);
 
 	if (m_fd < 0 || isatty(m_fd) == 0)
 		return RESULT_ERR_NOTFOUND;
@@ -180,24 +256,24 @@ result_t DeviceSerial::openDevice(const string deviceName, const bool noDeviceCh
 	// set serial device into blocking mode
 	fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_NONBLOCK);
 
-	m_open = true;
 	return RESULT_OK;
 }
 
 void DeviceSerial::closeDevice()
 {
-	if (m_open == true) {
-		// empty device buffer
-		tcflush(m_fd, TCIOFLUSH);
+	if (m_fd >= 0) {
+		if (isatty(m_fd) != 0) {
+			// empty device buffer
+			tcflush(m_fd, TCIOFLUSH);
 
-		// activate old settings of serial device
-		tcsetattr(m_fd, TCSANOW, &m_oldSettings);
+			// activate old settings of serial device
+			tcsetattr(m_fd, TCSANOW, &m_oldSettings);
+		}
 
 		// close file descriptor from serial device
-		close(m_fd);
+		::close(m_fd);
 
 		m_fd = -1;
-		m_open = false;
 	}
 }
 
@@ -205,72 +281,467 @@ void DeviceSerial::closeDevice()
 result_t DeviceNetwork::openDevice(const string deviceName, const bool noDeviceCheck)
 {
 	m_noDeviceCheck = noDeviceCheck;
+	clearRecvBuffer();
 
-	struct sockaddr_in sock;
-	char* hostport;
-	int ret;
-
-	m_open = false;
+	size_t pos = deviceName.rfind(':');
+	if (pos == string::npos || pos == 0 || pos + 1 == deviceName.length())
+		return RESULT_ERR_NOTFOUND;
 
-	memset((char*) &sock, 0, sizeof(sock));
+	string host = deviceName.substr(0, pos);
+	string port = deviceName.substr(pos + 1);
+	if (host.length() > 2 && host[0] == '[' && host[host.length()-1] == ']')
+		host = host.substr(1, host.length()-2); // IPv6 address
 
-	hostport = strdup(deviceName.c_str());
-	char* host = strtok(hostport, ":");
-	char* port = strtok(NULL, ":");
+	struct addrinfo hints, *addresses;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+		return RESULT_ERR_NOTFOUND;
 
-	if (inet_addr(host) == INADDR_NONE) {
-		struct hostent* he;
+	result_t result = RESULT_ERR_NOTFOUND;
+	for (struct addrinfo* address = addresses; address != NULL; address = address->ai_next) {
+		m_fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (m_fd < 0) {
+			result = RESULT_ERR_GENERIC_IO;
+			continue;
+		}
 
-		he = gethostbyname(host);
-		if (he == NULL)
-			return RESULT_ERR_NOTFOUND;
+		result = connectSocket(address->ai_addr, address->ai_addrlen);
+		if (result == RESULT_OK)
+			break;
 
-		memcpy(&sock.sin_addr, he->h_addr_list[0], he->h_length);
-	} else {
-		ret = inet_aton(host, &sock.sin_addr);
-		if (ret == 0)
-			return RESULT_ERR_NOTFOUND;
+		::close(m_fd);
+		m_fd = -1;
 	}
+	freeaddrinfo(addresses);
 
-	sock.sin_family = AF_INET;
-	sock.sin_port = htons(strtol(port, NULL, 10));
+	if (result != RESULT_OK)
+		return result;
 
-	m_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (m_fd < 0)
-		return RESULT_ERR_GENERIC_IO;
+	setSocketOptions();
+
+	return RESULT_OK;
+}
 
-	ret = connect(m_fd, (struct sockaddr*) &sock, sizeof(sock));
-	if (ret < 0)
+result_t DeviceNetwork::connectSocket(const struct sockaddr* address, const socklen_t addressLen)
+{
+	int flags = fcntl(m_fd, F_GETFL);
+	if (flags < 0 || fcntl(m_fd, F_SETFL, flags | O_NONBLOCK) < 0)
 		return RESULT_ERR_GENERIC_IO;
 
-	free(hostport);
-	m_open = true;
+	if (connect(m_fd, address, addressLen) < 0) {
+		if (errno != EINPROGRESS)
+			return RESULT_ERR_GENERIC_IO;
+
+		struct pollfd fds[1];
+		memset(fds, 0, sizeof(fds));
+		fds[0].fd = m_fd;
+		fds[0].events = POLLOUT;
+
+		int ret = poll(fds, 1, NETWORK_CONNECT_TIMEOUT/1000);
+		if (ret == 0)
+			return RESULT_ERR_TIMEOUT;
+
+		int error = 0;
+		socklen_t errorLen = sizeof(error);
+		if (ret < 0 || getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0 || error != 0)
+			return RESULT_ERR_GENERIC_IO;
+	}
+
+	// back to blocking mode for sending
+	if (fcntl(m_fd, F_SETFL, flags) < 0)
+		return RESULT_ERR_GENERIC_IO;
 
 	return RESULT_OK;
 }
 
+void DeviceNetwork::setSocketOptions()
+{
+	int value = 1;
+	// send each symbol immediately instead of waiting for outstanding acknowledges
+	setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+#ifdef TCP_QUICKACK
+	setsockopt(m_fd, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+#endif
+
+	// detect a dead peer even while the bus is idle
+	setsockopt(m_fd, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(value));
+#ifdef TCP_KEEPIDLE
+	value = NETWORK_KEEPALIVE_IDLE;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof(value));
+#endif
+#ifdef TCP_KEEPINTVL
+	value = NETWORK_KEEPALIVE_INTERVAL;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof(value));
+#endif
+#ifdef TCP_KEEPCNT
+	value = NETWORK_KEEPALIVE_COUNT;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof(value));
+#endif
+}
+
+ssize_t DeviceNetwork::sendBytes(const unsigned char* buffer, size_t nbytes)
+{
+#ifdef MSG_NOSIGNAL
+	ssize_t ret = ::send(m_fd, buffer, nbytes, MSG_NOSIGNAL);
+#else
+	ssize_t ret = ::send(m_fd, buffer, nbytes, 0);
+#endif
+	if (ret < 0 && isHangup(errno) == true)
+		return RESULT_ERR_DEVICE;
+
+	return ret;
+}
+
+bool DeviceNetwork::isValid()
+{
+	int error = 0;
+	socklen_t errorLen = sizeof(error);
+	if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0 || error != 0)
+		return false;
+
+	struct pollfd fds[1];
+	memset(fds, 0, sizeof(fds));
+	fds[0].fd = m_fd;
+	return poll(fds, 1, 0) == 0 || (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) == 0;
+}
+
+result_t DeviceNetwork::fillRecvBuffer(const long timeout)
+{
+	result_t result = Device::fillRecvBuffer(timeout);
+#ifdef TCP_QUICKACK
+	// the kernel falls back to delayed acknowledges, so re-enable after each read
+	if (result == RESULT_OK) {
+		int value = 1;
+		setsockopt(m_fd, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+	}
+#endif
+	return result;
+}
+
 void DeviceNetwork::closeDevice()
 {
-	if (m_open == true) {
+	if (m_fd >= 0) {
 		// close file descriptor from network device
-		close(m_fd);
+		::close(m_fd);
 
 		m_fd = -1;
-		m_open = false;
+	}
+}
+
+
+result_t DeviceReplay::openDevice(const string deviceName, const bool noDeviceCheck)
+{
+	m_noDeviceCheck = noDeviceCheck;
+	clearRecvBuffer();
+
+	string fileName = deviceName.substr(strlen(REPLAY_PREFIX));
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return RESULT_ERR_NOTFOUND;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return RESULT_ERR_NOTFOUND;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // mapping stays valid
+	if (data == MAP_FAILED)
+		return RESULT_ERR_GENERIC_IO;
+
+	m_data = (unsigned char*)data;
+	m_size = st.st_size;
+	m_pos = 0;
+	m_capture = m_reader.open(m_data, m_size) == RESULT_OK;
+	m_recordPos = m_recordCount = 0;
+	m_firstTime = 0;
+	m_startTime = getMonotonicTime();
+	return RESULT_OK;
+}
+
+void DeviceReplay::closeDevice()
+{
+	if (m_data != NULL) {
+		m_reader.close();
+		munmap(m_data, m_size);
+		m_data = NULL;
+	}
+	m_echoCount = 0;
+}
+
+ssize_t DeviceReplay::sendBytes(const unsigned char* buffer, size_t nbytes)
+{
+	if (m_echo == true) {
+		// the receive buffer belongs to the receiving thread, so keep the echo aside
+		size_t count = RECV_BUFFER_SIZE - m_echoCount;
+		if (count > nbytes)
+			count = nbytes;
+		memcpy(m_echoBuffer + m_echoCount, buffer, count);
+		m_echoCount += count;
+	}
+	return nbytes;
+}
+
+result_t DeviceReplay::fillRecvBuffer(const long timeout)
+{
+	if (m_open == false)
+		return RESULT_ERR_DEVICE;
+
+	m_recvPos = m_recvCount = 0;
+	pthread_mutex_lock(&m_mutex);
+	if (m_echoCount > 0) {
+		memcpy(m_recvBuffer, m_echoBuffer, m_echoCount);
+		m_recvCount = m_echoCount;
+		m_echoCount = 0;
+	}
+	pthread_mutex_unlock(&m_mutex);
+	if (m_recvCount > 0) {
+		m_recvTime = getMonotonicTime();
+		return RESULT_OK;
+	}
+
+	// with echo, deliver single symbols so that no replayed data is ever buffered ahead of an echo
+	const size_t limit = m_echo == true ? 1 : RECV_BUFFER_SIZE;
+	while (m_recvCount < limit) {
+		if (m_recordPos >= m_recordCount) {
+			result_t result = nextRecord();
+			if (result != RESULT_OK) {
+				if (m_recvCount > 0)
+					break;
+				close(); // replay restarts when the device is reopened
+				return result;
+			}
+		}
+
+		if (m_speed > 0) {
+			unsigned long long due = m_startTime + (unsigned long long)((m_recordTime - m_firstTime) / m_speed);
+			unsigned long long now = getMonotonicTime();
+			if (due > now) {
+				if (m_recvCount > 0)
+					break; // deliver the symbols due so far
+
+				if (timeout > 0 && due - now > (unsigned long long)timeout) {
+					usleep(timeout);
+					return RESULT_ERR_TIMEOUT;
+				}
+				struct timespec delay;
+				delay.tv_sec = (due - now) / 1000000;
+				delay.tv_nsec = (due - now) % 1000000 * 1000;
+				nanosleep(&delay, NULL);
+			}
+		}
+
+		size_t count = m_recordCount - m_recordPos;
+		if (count > limit - m_recvCount)
+			count = limit - m_recvCount;
+		memcpy(m_recvBuffer + m_recvCount, m_recordData + m_recordPos, count);
+		m_recvCount += count;
+		m_recordPos += count;
+	}
+
+	m_recvTime = getMonotonicTime();
+	return RESULT_OK;
+}
+
+result_t DeviceReplay::nextRecord()
+{
+	m_recordPos = m_recordCount = 0;
+	if (m_capture == true) {
+		bool sent = true;
+		size_t count;
+		while (sent == true) {
+			result_t result = m_reader.next(m_recordTime, sent, m_record, count);
+			if (result != RESULT_OK)
+				return result;
+		}
+		m_recordData = m_record;
+		m_recordCount = count;
+		if (m_firstTime == 0)
+			m_firstTime = m_recordTime;
+		return RESULT_OK;
+	}
+
+	if (m_pos >= m_size)
+		return RESULT_ERR_EOF;
+
+	// plain dump file: one symbol at a time with the nominal symbol duration
+	m_recordData = m_data + m_pos;
+	m_recordCount = m_speed > 0 ? 1 : m_size - m_pos;
+	m_recordTime = (unsigned long long)m_pos * REPLAY_SYMBOL_DURATION;
+	m_pos += m_recordCount;
+	return RESULT_OK;
+}
+
+
+DumpWriter::DumpWriter(const string& fileName, const long maxSize, const bool capture)
+	: m_fileName(fileName), m_maxSize(maxSize), m_capture(capture),
+	  m_active(0), m_activeSize(0), m_pendingSize(0)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_cond, NULL);
+	openFile(capture); // capture format can not be appended to an existing file
+}
+
+DumpWriter::~DumpWriter()
+{
+	stop();
+	join();
+	m_stream.close();
+	pthread_mutex_destroy(&m_mutex);
+	pthread_cond_destroy(&m_cond);
+}
+
+size_t DumpWriter::write(const unsigned char* data, size_t count, const bool sent, const unsigned long long time)
+{
+	if (m_capture == false && sent == true)
+		return 0;
+
+	DumpEntry entry;
+	entry.time = m_capture == true ? time : 0;
+	entry.sent = sent;
+
+	pthread_mutex_lock(&m_mutex);
+	while (count > 0) {
+		size_t free = DUMP_BUFFER_SIZE - m_activeSize;
+		if (free <= sizeof(entry)) {
+			if (switchBuffers() == false)
+				break; // drop the rest
+			free = DUMP_BUFFER_SIZE;
+		}
+		free -= sizeof(entry);
+		if (free > count)
+			free = count;
+		if (free > CAPTURE_MAX_RECORD)
+			free = CAPTURE_MAX_RECORD;
+		entry.count = (unsigned short)free;
+		memcpy(m_buffers[m_active] + m_activeSize, &entry, sizeof(entry));
+		memcpy(m_buffers[m_active] + m_activeSize + sizeof(entry), data, free);
+		m_activeSize += sizeof(entry) + free;
+		data += free;
+		count -= free;
+	}
+	pthread_mutex_unlock(&m_mutex);
+	return count;
+}
+
+void DumpWriter::setMaxSize(const long maxSize)
+{
+	pthread_mutex_lock(&m_mutex);
+	m_maxSize = maxSize;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool DumpWriter::switchBuffers()
+{
+	if (m_pendingSize > 0)
+		return false;
+
+	m_pendingSize = m_activeSize;
+	m_active = 1 - m_active;
+	m_activeSize = 0;
+	pthread_cond_signal(&m_cond);
+	return true;
+}
+
+void DumpWriter::stop()
+{
+	pthread_mutex_lock(&m_mutex);
+	Thread::stop();
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void DumpWriter::run()
+{
+	pthread_mutex_lock(&m_mutex);
+	bool running = true;
+	while (running == true) {
+		running = isRunning();
+		if (running == true && m_pendingSize == 0) {
+			struct timespec abstime;
+			clock_gettime(CLOCK_REALTIME, &abstime);
+			abstime.tv_sec += DUMP_FLUSH_INTERVAL;
+			pthread_cond_timedwait(&m_cond, &m_mutex, &abstime);
+			running = isRunning();
+		}
+		if (m_pendingSize == 0 && m_activeSize > 0)
+			switchBuffers(); // flush interval elapsed or stopping
+		if (m_pendingSize == 0)
+			continue;
+
+		// write the other buffer without holding the lock
+		const unsigned char* data = m_buffers[1 - m_active];
+		size_t count = m_pendingSize;
+		long maxSize = m_maxSize;
+		pthread_mutex_unlock(&m_mutex);
+		writeFile(data, count, maxSize);
+		pthread_mutex_lock(&m_mutex);
+		m_pendingSize = 0;
+		if (running == false && m_activeSize > 0)
+			running = true; // write the remainder before stopping
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void DumpWriter::writeFile(const unsigned char* data, size_t count, const long maxSize)
+{
+	if (m_stream.is_open() == false)
+		return;
+
+	const unsigned char* end = data + count;
+	while (data < end) {
+		DumpEntry entry;
+		memcpy(&entry, data, sizeof(entry));
+		data += sizeof(entry);
+		if (m_capture == true) {
+			size_t length = m_encoder.encode(entry.time, entry.sent, data, entry.count, m_encoded);
+			m_stream.write((char*)m_encoded, length);
+		}
+		else
+			m_stream.write((char*)data, entry.count);
+		data += entry.count;
+	}
+	m_stream.flush();
+
+	if (m_stream.tellp() >= maxSize * 1024) {
+		m_stream.close();
+		openFile(true);
+	}
+}
+
+void DumpWriter::openFile(const bool rotate)
+{
+	if (rotate == true) {
+		string oldfile = m_fileName + ".old";
+		rename(m_fileName.c_str(), oldfile.c_str());
+	}
+	m_stream.open(m_fileName.c_str(), ios::out | ios::binary | ios::app);
+	if (m_capture == true && m_stream.is_open() == true) {
+		size_t length = m_encoder.begin(m_encoded);
+		m_stream.write((char*)m_encoded, length);
+		m_stream.flush();
 	}
 }
 
 
 Port::Port(const string deviceName, const bool noDeviceCheck,
 		const bool logRaw, void (*logRawFunc)(const unsigned char byte, bool received),
-		const bool dumpRaw, const char* dumpRawFile, const long dumpRawMaxSize)
+		const bool dumpRaw, const char* dumpRawFile, const long dumpRawMaxSize,
+		const bool dumpRawCapture, const float replaySpeed, const bool replayEcho)
 	: m_deviceName(deviceName), m_noDeviceCheck(noDeviceCheck),
+	  m_replaySpeed(replaySpeed), m_replayEcho(replayEcho),
 	  m_logRaw(logRaw), m_logRawFunc(logRawFunc),
-	  m_dumpRawFile(dumpRawFile), m_dumpRawMaxSize(dumpRawMaxSize)
+	  m_dumpRawFile(dumpRawFile), m_dumpRawMaxSize(dumpRawMaxSize),
+	  m_dumpRawCapture(dumpRawCapture), m_dumpRawWriter(NULL), m_dumpRawDropped(0)
 {
 	m_device = NULL;
+	pthread_mutex_init(&m_dumpRawMutex, NULL);
 
-	if (strchr(deviceName.c_str(), '/') == NULL &&
+	if (deviceName.compare(0, strlen(REPLAY_PREFIX), REPLAY_PREFIX) == 0)
+		setType(dt_replay);
+	else if (strchr(deviceName.c_str(), '/') == NULL &&
 	    strchr(deviceName.c_str(), ':') != NULL)
 		setType(dt_network);
 	else
@@ -278,14 +749,26 @@ Port::Port(const string deviceName, const bool noDeviceCheck,
 
 	m_dumpRaw = false;
 
-	setDumpRaw(dumpRaw); // open fstream if necessary
+	setDumpRaw(dumpRaw); // start DumpWriter if necessary
+}
+
+Port::~Port()
+{
+	delete m_device;
+	if (m_dumpRawWriter != NULL)
+		delete m_dumpRawWriter;
+	pthread_mutex_destroy(&m_dumpRawMutex);
 }
 
 ssize_t Port::send(const unsigned char* buffer, size_t nbytes)
 {
-	ssize_t ret = m_device->sendBytes(buffer, nbytes);
-	if (ret>0 && m_logRaw == true && m_logRawFunc != NULL)
-		(*m_logRawFunc)(buffer[0], false);
+	ssize_t ret = m_device->send(buffer, nbytes);
+	if (ret > 0 && m_logRaw == true && m_logRawFunc != NULL) {
+		for (ssize_t pos = 0; pos < ret; pos++)
+			(*m_logRawFunc)(buffer[pos], false);
+	}
+	if (ret > 0)
+		dumpRaw(buffer, ret, true, getMonotonicTime());
 	return ret;
 }
 
@@ -298,18 +781,8 @@ ssize_t Port::recv(const long timeout, size_t maxCount, unsigned char* buffer)
 				(*m_logRawFunc)(buffer[pos], true);
 		}
 
-		if (m_dumpRaw == true && m_dumpRawStream.is_open() == true) {
-			m_dumpRawStream.write((char*)buffer, ret);
-			m_dumpRawStream.flush();
-
-			if (m_dumpRawStream.tellp() >= m_dumpRawMaxSize * 1024) {
-				string oldfile = m_dumpRawFile + ".old";
-				if (rename(m_dumpRawFile.c_str(), oldfile.c_str()) == 0) {
-					m_dumpRawStream.close();
-					m_dumpRawStream.open(m_dumpRawFile.c_str(), ios::out | ios::binary | ios::app);
-				}
-			}
-		}
+		// stamp with the time the bytes were read, not when they were consumed
+		dumpRaw(buffer, ret, false, m_device->getRecvTime());
 	}
 
 	return ret;
@@ -322,43 +795,68 @@ unsigned char Port::byte()
 	if (m_logRaw == true && m_logRawFunc != NULL)
 		(*m_logRawFunc)(byte, true);
 
-	if (m_dumpRaw == true && m_dumpRawStream.is_open() == true) {
-		m_dumpRawStream.write((char*)&byte, 1);
-
-		if (m_dumpRawStream.tellp() >= m_dumpRawMaxSize * 1024) {
-			string oldfile = m_dumpRawFile + ".old";
-			if (rename(m_dumpRawFile.c_str(), oldfile.c_str()) == 0) {
-				m_dumpRawStream.close();
-				m_dumpRawStream.open(m_dumpRawFile.c_str(), ios::out | ios::binary | ios::app);
-			}
-		}
-	}
+	dumpRaw(&byte, 1, false, m_device->getRecvTime());
 
 	return byte;
 }
 
+void Port::dumpRaw(const unsigned char* data, size_t count, const bool sent, const unsigned long long time)
+{
+	pthread_mutex_lock(&m_dumpRawMutex);
+	if (m_dumpRawWriter != NULL)
+		m_dumpRawDropped += m_dumpRawWriter->write(data, count, sent, time);
+	pthread_mutex_unlock(&m_dumpRawMutex);
+}
+
 void Port::setDumpRaw(bool dumpRaw)
 {
 	if (dumpRaw == m_dumpRaw)
 		return;
 
+	DumpWriter* writer = NULL;
+	if (dumpRaw == true) {
+		writer = new DumpWriter(m_dumpRawFile, m_dumpRawMaxSize, m_dumpRawCapture);
+		writer->start("dumpwriter");
+	}
+
+	// no other thread can access the old writer after the swap
+	pthread_mutex_lock(&m_dumpRawMutex);
+	DumpWriter* oldWriter = m_dumpRawWriter;
+	m_dumpRawWriter = writer;
+	pthread_mutex_unlock(&m_dumpRawMutex);
 	m_dumpRaw = dumpRaw;
 
-	if (dumpRaw == false)
-		m_dumpRawStream.close();
-	else
-		m_dumpRawStream.open(m_dumpRawFile.c_str(), ios::out | ios::binary | ios::app);
+	if (oldWriter != NULL)
+		delete oldWriter; // writes the remaining data
 }
 
 void Port::setDumpRawFile(const string& dumpFile) {
 	if (dumpFile == m_dumpRawFile)
 		return;
 
-	m_dumpRawStream.close();
 	m_dumpRawFile = dumpFile;
 
-	if (m_dumpRaw == true)
-		m_dumpRawStream.open(m_dumpRawFile.c_str(), ios::out | ios::binary | ios::app);
+	if (m_dumpRaw == true) {
+		m_dumpRaw = false;
+		setDumpRaw(true); // restart DumpWriter with new file
+	}
+}
+
+void Port::setDumpRawMaxSize(const long maxSize)
+{
+	m_dumpRawMaxSize = maxSize;
+	pthread_mutex_lock(&m_dumpRawMutex);
+	if (m_dumpRawWriter != NULL)
+		m_dumpRawWriter->setMaxSize(maxSize);
+	pthread_mutex_unlock(&m_dumpRawMutex);
+}
+
+unsigned long Port::getDumpRawDropped()
+{
+	pthread_mutex_lock(&m_dumpRawMutex);
+	unsigned long dropped = m_dumpRawDropped;
+	pthread_mutex_unlock(&m_dumpRawMutex);
+	return dropped;
 }
 
 void Port::setType(const DeviceType type)
@@ -373,6 +871,9 @@ void Port::setType(const DeviceType type)
 	case dt_network:
 		m_device = new DeviceNetwork();
 		break;
+	case dt_replay:
+		m_device = new DeviceReplay(m_replaySpeed, m_replayEcho);
+		break;
 	};
 };
 
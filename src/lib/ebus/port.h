@@ -21,12 +21,14 @@
 #define LIBEBUS_PORT_H_
 
 #include <string>
-#include <queue>
 #include <termios.h>
 #include <unistd.h>
 #include <iostream>
 #include <fstream>
+#include <pthread.h>
 #include "result.h"
+#include "capture.h"
+#include "thread.h"
 
 using namespace std;
 
@@ -35,7 +37,8 @@ using namespace std;
 /** available device types. */
 enum DeviceType {
 	dt_serial,  /*!< serial device */
-	dt_network  /*!< network device */
+	dt_network, /*!< network device */
+	dt_replay   /*!< replay of a dump file */
 };
 
 /** max bytes write to bus. */
@@ -44,9 +47,41 @@ enum DeviceType {
 /** max size of receive buffer. */
 #define MAX_READ_SIZE 100
 
+/** the size of the device receive buffer filled by a single read. */
+#define RECV_BUFFER_SIZE 256
+
+/** the size of each of the two buffers of the @a DumpWriter. */
+#define DUMP_BUFFER_SIZE 8192
+
+/** the maximum time [s] dumped data is kept in the @a DumpWriter buffer before being written. */
+#define DUMP_FLUSH_INTERVAL 1
+
+/** the maximum time [us] for establishing the connection to a network device. */
+#define NETWORK_CONNECT_TIMEOUT 5000000
+
+/** the idle time [s] after which TCP keepalive probes are sent to a network device. */
+#define NETWORK_KEEPALIVE_IDLE 10
+
+/** the interval [s] between TCP keepalive probes sent to a network device. */
+#define NETWORK_KEEPALIVE_INTERVAL 5
+
+/** the number of unanswered TCP keepalive probes after which a network device is considered dead. */
+#define NETWORK_KEEPALIVE_COUNT 3
+
+/** the interval [us] for probing an idle device whether it is still present. */
+#define DEVICE_CHECK_INTERVAL 5000000
+
+/** the device name prefix for replaying a dump file instead of accessing a real device. */
+#define REPLAY_PREFIX "replay:"
+
+/** the duration [us] of a single symbol at 2400Bd used for replaying plain dump files. */
+#define REPLAY_SYMBOL_DURATION 4167
+
 
 /**
  * @brief base class for input devices.
+ * Receiving (including the detection of hangups) may happen in a different thread than
+ * sending, as long as opening and closing is done by the receiving thread only.
  */
 class Device
 {
@@ -55,45 +90,55 @@ public:
 	/**
 	 * @brief constructs a new instance.
 	 */
-	Device() : m_fd(-1), m_open(false), m_noDeviceCheck(false) {}
+	Device() : m_fd(-1), m_open(false), m_noDeviceCheck(false), m_lastCheck(0), m_recvPos(0), m_recvCount(0),
+		m_recvTime(0)
+	{
+		pthread_mutex_init(&m_mutex, NULL);
+	}
 
 	/**
 	 * @brief destructor.
 	 */
-	virtual ~Device() {}
+	virtual ~Device() { pthread_mutex_destroy(&m_mutex); }
 
 	/**
-	 * @brief virtual open function for opening file descriptor
+	 * @brief open the device (closing it first if necessary).
 	 * @param deviceName to determine device type.
 	 * @param noDeviceCheck en-/disable device check.
+	 * @return RESULT_OK on success, or an error code.
 	 */
-	virtual result_t openDevice(const string deviceName, const bool noDeviceCheck) = 0;
+	result_t open(const string deviceName, const bool noDeviceCheck);
 
 	/**
-	 * @brief virtual close function for closing opened file descriptor
+	 * @brief close the device.
 	 */
-	virtual void closeDevice() = 0;
+	void close();
 
 	/**
 	 * @brief connection state of device.
+	 * Hangups and I/O errors are detected while receiving. In addition,
+	 * the device is probed every @a DEVICE_CHECK_INTERVAL if the receive buffer is empty.
 	 * @return true if device is open
 	 */
 	bool isOpen();
 
 	/**
-	 * @brief sendBytes write bytes to opened file descriptor.
+	 * @brief write bytes to the opened device.
 	 * @param buffer data to send.
 	 * @param nbytes number of bytes to send.
-	 * @return number of written bytes or -1 if an error has occured.
+	 * @return number of written bytes or a negative result_t code.
 	 */
-	ssize_t sendBytes(const unsigned char* buffer, size_t nbytes);
+	ssize_t send(const unsigned char* buffer, size_t nbytes);
 
 	/**
-	 * @brief recvBytes read bytes from opened file descriptor.
-	 * @param timeout time for new input data [usec].
-	 * @param maxCount max size of receive buffer.
-	 * @param buffer optional direct buffer to write to (instead of queuing the data).
-	 * @return number of read bytes or -1 if an error has occured.
+	 * @brief recvBytes read bytes from the receive buffer.
+	 * The opened file descriptor is only read when the receive buffer is empty,
+	 * in which case all bytes available are read into the receive buffer at once.
+	 * @param timeout time for new input data [usec], or 0 for infinite
+	 * (only relevant if the receive buffer is empty).
+	 * @param maxCount max number of bytes to fetch.
+	 * @param buffer optional direct buffer to write to (instead of keeping the data in the receive buffer).
+	 * @return number of fetched (or available if @a buffer is NULL) bytes or a negative result_t code.
 	 */
 	ssize_t recvBytes(const long timeout, size_t maxCount, unsigned char* buffer=NULL);
 
@@ -107,30 +152,95 @@ public:
 	 * @brief get current size (bytes) of the receive buffer.
 	 * @return number of bytes in queued.
 	 */
-	ssize_t sizeRecvBuffer() const { return m_recvBuffer.size(); }
+	ssize_t sizeRecvBuffer() const { return m_recvCount; }
+
+	/**
+	 * @brief get the time the bytes in the receive buffer were read from the device.
+	 * @return the monotonic time [us] the receive buffer was filled.
+	 */
+	unsigned long long getRecvTime() const { return m_recvTime; }
 
 protected:
 	/** file descriptor from input device */
 	int m_fd;
 
-	/** true if device is opened */
+	/** true if device is opened (guarded by @a m_mutex) */
 	bool m_open;
 
 	/** true if device check is disabled */
 	bool m_noDeviceCheck;
 
-	/** queue for received bytes */
-	queue<unsigned char> m_recvBuffer;
+	/** the monotonic time [us] of the last device probe */
+	unsigned long long m_lastCheck;
 
 	/** receive buffer */
-	unsigned char m_buffer[MAX_READ_SIZE];
+	unsigned char m_recvBuffer[RECV_BUFFER_SIZE];
+
+	/** the position of the next byte to fetch from @a m_recvBuffer */
+	size_t m_recvPos;
+
+	/** the number of bytes not yet fetched from @a m_recvBuffer */
+	size_t m_recvCount;
+
+	/** the monotonic time [us] @a m_recvBuffer was filled */
+	unsigned long long m_recvTime;
+
+	/** mutex for sending and for changing @a m_open and @a m_fd while open */
+	pthread_mutex_t m_mutex;
+
+	/**
+	 * @brief virtual open function for opening file descriptor (called without holding @a m_mutex).
+	 * @param deviceName to determine device type.
+	 * @param noDeviceCheck en-/disable device check.
+	 * @return RESULT_OK on success, or an error code.
+	 */
+	virtual result_t openDevice(const string deviceName, const bool noDeviceCheck) = 0;
+
+	/**
+	 * @brief virtual close function for closing opened file descriptor (called with @a m_mutex held).
+	 */
+	virtual void closeDevice() = 0;
+
+	/**
+	 * @brief write bytes to the opened file descriptor (called with @a m_mutex held).
+	 * A hangup is not handled here, but left to the receiving side.
+	 * @param buffer data to send.
+	 * @param nbytes number of bytes to send.
+	 * @return number of written bytes or a negative result_t code.
+	 */
+	virtual ssize_t sendBytes(const unsigned char* buffer, size_t nbytes);
+
+	/**
+	 * @brief discard all bytes not yet fetched from the receive buffer.
+	 */
+	void clearRecvBuffer() { m_recvPos = m_recvCount = 0; }
+
+	/**
+	 * @brief wait for input data and read all available bytes into the empty receive buffer.
+	 * @param timeout time for new input data [usec], or 0 for infinite.
+	 * @return RESULT_OK on success, or an error code.
+	 */
+	virtual result_t fillRecvBuffer(const long timeout);
+
+	/**
+	 * @brief check whether the errno value indicates a hangup or fatal I/O error.
+	 * @param error the errno value, or 0 for a hangup.
+	 * @return true for a hangup or fatal I/O error.
+	 */
+	static bool isHangup(const int error);
+
+	/**
+	 * @brief close the device after a hangup or fatal I/O error.
+	 * @param error the errno value, or 0 for a hangup.
+	 * @return true if the device was closed.
+	 */
+	bool checkHangup(const int error);
 
-private:
 	/**
 	 * @brief system check if opened file descriptor is valid
 	 * @return true if file descriptor is valid
 	 */
-	bool isValid();
+	virtual bool isValid();
 
 };
 
@@ -146,6 +256,7 @@ public:
 	 */
 	~DeviceSerial() { closeDevice(); }
 
+protected:
 	/**
 	 * @brief open function for opening file descriptor
 	 * @param deviceName to determine device type.
@@ -176,6 +287,7 @@ public:
 	 */
 	~DeviceNetwork() { closeDevice(); }
 
+protected:
 	/**
 	 * @brief open function for opening file descriptor
 	 * @param deviceName to determine device type.
@@ -188,7 +300,276 @@ public:
 	 */
 	void closeDevice();
 
+	/**
+	 * @brief write bytes to the socket without raising SIGPIPE on a closed connection.
+	 * @param buffer data to send.
+	 * @param nbytes number of bytes to send.
+	 * @return number of written bytes or a negative result_t code.
+	 */
+	virtual ssize_t sendBytes(const unsigned char* buffer, size_t nbytes);
+
+	/**
+	 * @brief wait for input data and read all available bytes into the empty receive buffer.
+	 * Re-enables the immediate acknowledgement of received data afterwards.
+	 * @param timeout time for new input data [usec], or 0 for infinite.
+	 * @return RESULT_OK on success, or an error code.
+	 */
+	virtual result_t fillRecvBuffer(const long timeout);
+
+	/**
+	 * @brief check for a pending error or hangup on the socket.
+	 * @return true if the socket is valid.
+	 */
+	virtual bool isValid();
+
 private:
+	/**
+	 * @brief connect the socket within @a NETWORK_CONNECT_TIMEOUT.
+	 * @param address the address to connect to.
+	 * @param addressLen the length of @a address.
+	 * @return RESULT_OK on success, or an error code.
+	 */
+	result_t connectSocket(const struct sockaddr* address, const socklen_t addressLen);
+
+	/**
+	 * @brief set the socket options for low latency and dead peer detection.
+	 */
+	void setSocketOptions();
+
+};
+
+/**
+ * @brief class for replaying a plain or capture format dump file from memory.
+ * The device name is the file name prefixed with @a REPLAY_PREFIX.
+ */
+class DeviceReplay : public Device
+{
+
+public:
+	/**
+	 * @brief constructs a new instance.
+	 * @param speed the replay speed factor relative to the original timing, or 0 for as fast as possible.
+	 * @param echo whether to echo sent bytes (otherwise they are dropped).
+	 */
+	DeviceReplay(const float speed, const bool echo)
+		: m_speed(speed), m_echo(echo), m_data(NULL), m_size(0), m_pos(0), m_capture(false),
+		  m_startTime(0), m_firstTime(0), m_recordData(NULL), m_recordPos(0), m_recordCount(0), m_recordTime(0),
+		  m_echoCount(0) {}
+
+	/**
+	 * @brief destructor.
+	 */
+	~DeviceReplay() { closeDevice(); }
+
+protected:
+	/**
+	 * @brief map the dump file into memory.
+	 * @param deviceName the file name prefixed with @a REPLAY_PREFIX.
+	 * @param noDeviceCheck ignored.
+	 */
+	virtual result_t openDevice(const string deviceName, const bool noDeviceCheck);
+
+	/**
+	 * @brief unmap the dump file.
+	 */
+	void closeDevice();
+
+	/**
+	 * @brief drop or echo the bytes.
+	 * @param buffer data to send.
+	 * @param nbytes number of bytes to send.
+	 * @return number of "written" bytes or a negative result_t code.
+	 */
+	virtual ssize_t sendBytes(const unsigned char* buffer, size_t nbytes);
+
+	/**
+	 * @brief fill the receive buffer with the echoed bytes, or otherwise with the symbols due until now from the dump file
+	 * (only a single symbol when echoing, so that an echo is never queued behind replayed symbols).
+	 * @param timeout time for new input data [usec], or 0 for infinite.
+	 * @return RESULT_OK on success, or an error code.
+	 */
+	virtual result_t fillRecvBuffer(const long timeout);
+
+	/**
+	 * @brief the dump file is always valid.
+	 * @return true.
+	 */
+	virtual bool isValid() { return true; }
+
+private:
+	/**
+	 * @brief advance to the next record of received symbols.
+	 * @return RESULT_OK on success, or RESULT_ERR_EOF at the end of the file.
+	 */
+	result_t nextRecord();
+
+	/** the replay speed factor relative to the original timing, or 0 for as fast as possible. */
+	const float m_speed;
+
+	/** whether to echo sent bytes. */
+	const bool m_echo;
+
+	/** the mapped dump file, or NULL. */
+	unsigned char* m_data;
+
+	/** the size of @a m_data. */
+	size_t m_size;
+
+	/** the position of the next symbol in a plain dump file. */
+	size_t m_pos;
+
+	/** whether the dump file is in capture format. */
+	bool m_capture;
+
+	/** the @a CaptureReader for the capture format. */
+	CaptureReader m_reader;
+
+	/** the monotonic time the replay was started. */
+	unsigned long long m_startTime;
+
+	/** the time of the first record. */
+	unsigned long long m_firstTime;
+
+	/** the buffer for the current record in capture format. */
+	unsigned char m_record[CAPTURE_MAX_RECORD];
+
+	/** the symbols of the current record. */
+	const unsigned char* m_recordData;
+
+	/** the position of the next symbol in @a m_recordData. */
+	size_t m_recordPos;
+
+	/** the number of symbols in @a m_recordData. */
+	size_t m_recordCount;
+
+	/** the time of the current record. */
+	unsigned long long m_recordTime;
+
+	/** the echoed bytes not yet moved to the receive buffer (guarded by @a m_mutex). */
+	unsigned char m_echoBuffer[RECV_BUFFER_SIZE];
+
+	/** the number of bytes in @a m_echoBuffer (guarded by @a m_mutex). */
+	size_t m_echoCount;
+
+};
+
+/** the header of an entry in the @a DumpWriter buffers. */
+struct DumpEntry
+{
+	/** the monotonic time of the entry in microseconds. */
+	unsigned long long time;
+
+	/** the number of bytes following this header. */
+	unsigned short count;
+
+	/** whether the bytes were sent. */
+	bool sent;
+};
+
+/**
+ * @brief writes raw data to a dump file in a background thread using a double buffer.
+ * The file is either a plain stream of the received bytes, or in capture format
+ * (see capture.h) with the timing of received and sent bytes.
+ */
+class DumpWriter : public Thread
+{
+
+public:
+	/**
+	 * @brief constructs a new instance.
+	 * @param fileName the name of the file to dump raw data to.
+	 * @param maxSize the maximum size of the file in kB before it is rotated.
+	 * @param capture whether to write the capture format instead of plain received bytes.
+	 */
+	DumpWriter(const string& fileName, const long maxSize, const bool capture);
+
+	/**
+	 * @brief destructor, writes all remaining data.
+	 */
+	virtual ~DumpWriter();
+
+	/**
+	 * @brief add raw data to the active buffer without doing any file I/O.
+	 * @param data the data to add.
+	 * @param count the number of bytes in @a data.
+	 * @param sent whether the data was sent instead of received.
+	 * @param time the monotonic time [us] the data was received from or sent to the device.
+	 * @return the number of bytes dropped because the background thread fell behind.
+	 */
+	size_t write(const unsigned char* data, size_t count, const bool sent, const unsigned long long time);
+
+	/**
+	 * @brief Set the maximum size of the file.
+	 * @param maxSize the maximum size of the file in kB before it is rotated.
+	 */
+	void setMaxSize(const long maxSize);
+
+	/**
+	 * @brief Notify the thread that it shall stop.
+	 */
+	virtual void stop();
+
+	/**
+	 * @brief Thread entry method.
+	 */
+	virtual void run();
+
+private:
+	/**
+	 * @brief write a full buffer to the file and rotate it if necessary.
+	 * @param data the buffer with @a DumpEntry headers each followed by the bytes.
+	 * @param count the number of bytes in @a data.
+	 * @param maxSize the maximum size of the file in kB before it is rotated.
+	 */
+	void writeFile(const unsigned char* data, size_t count, const long maxSize);
+
+	/**
+	 * @brief open the file and write the capture header if necessary.
+	 * @param rotate whether to move an existing file to the ".old" file first.
+	 */
+	void openFile(const bool rotate);
+
+	/**
+	 * @brief hand the active buffer over to the background thread (mutex must be held).
+	 * @return true if the buffers were switched, false if the other buffer is still being written.
+	 */
+	bool switchBuffers();
+
+	/** the name of the file to dump raw data to. */
+	const string m_fileName;
+
+	/** the maximum size of the file in kB before it is rotated (guarded by @a m_mutex). */
+	long m_maxSize;
+
+	/** whether to write the capture format instead of plain received bytes. */
+	const bool m_capture;
+
+	/** the @a CaptureEncoder for the capture format. */
+	CaptureEncoder m_encoder;
+
+	/** the buffer for encoding a capture record. */
+	unsigned char m_encoded[CAPTURE_MAX_ENCODED];
+
+	/** the @a ofstream for dumping raw data to. */
+	ofstream m_stream;
+
+	/** the two buffers. */
+	unsigned char m_buffers[2][DUMP_BUFFER_SIZE];
+
+	/** the index of the buffer currently being filled. */
+	int m_active;
+
+	/** the number of bytes in the active buffer. */
+	size_t m_activeSize;
+
+	/** the number of bytes in the other buffer still to be written, or 0 if it is free. */
+	size_t m_pendingSize;
+
+	/** mutex variable for exclusive lock */
+	pthread_mutex_t m_mutex;
+
+	/** condition variable for waking up the background thread */
+	pthread_cond_t m_cond;
 
 };
 
@@ -208,25 +589,35 @@ public:
 	 * @param dumpRaw whether dumping of raw data to a file is enabled.
 	 * @param dumpRawFile the name of the file to dump raw data to.
 	 * @param dumpRawMaxSize the maximum size of @a m_dumpFile.
+	 * @param dumpRawCapture whether to dump in capture format with timing and sent bytes.
+	 * @param replaySpeed the speed factor for replaying a dump file, or 0 for as fast as possible.
+	 * @param replayEcho whether to echo sent bytes when replaying a dump file.
 	 */
 	Port(const string deviceName, const bool noDeviceCheck,
 		const bool logRaw, void (*logRawFunc)(const unsigned char byte, bool received),
-		const bool dumpRaw, const char* dumpRawFile, const long dumpRawMaxSize);
+		const bool dumpRaw, const char* dumpRawFile, const long dumpRawMaxSize,
+		const bool dumpRawCapture=false, const float replaySpeed=1, const bool replayEcho=false);
 
 	/**
 	 * @brief destructor.
 	 */
-	~Port() { delete m_device; m_dumpRawStream.close(); }
+	~Port();
 
 	/**
 	 * @brief open device
 	 */
-	result_t open() { return m_device->openDevice(m_deviceName, m_noDeviceCheck); }
+	result_t open() { return m_device->open(m_deviceName, m_noDeviceCheck); }
 
 	/**
 	 * @brief close device
 	 */
-	void close() { m_device->closeDevice(); }
+	void close() { m_device->close(); }
+
+	/**
+	 * @brief Get the device name.
+	 * @return the device name.
+	 */
+	const string& getDeviceName() const { return m_deviceName; }
 
 	/**
 	 * @brief connection state of device.
@@ -297,7 +688,13 @@ public:
 	 * @brief Set the maximum size of a file to dump raw data to.
 	 * @param maxSize the maximum size of a file to dump raw data to.
 	 */
-	void setDumpRawMaxSize(const long maxSize) { m_dumpRawMaxSize = maxSize; }
+	void setDumpRawMaxSize(const long maxSize);
+
+	/**
+	 * @brief Get the number of raw bytes dropped because the dump file could not be written fast enough.
+	 * @return the number of dropped bytes since the instance was created.
+	 */
+	unsigned long getDumpRawDropped();
 
 private:
 	/** the device name */
@@ -309,6 +706,12 @@ private:
 	/** true if device check is disabled */
 	bool m_noDeviceCheck;
 
+	/** the speed factor for replaying a dump file, or 0 for as fast as possible. */
+	const float m_replaySpeed;
+
+	/** whether to echo sent bytes when replaying a dump file. */
+	const bool m_replayEcho;
+
 	/** whether logging of raw data is enabled. */
 	bool m_logRaw;
 
@@ -324,8 +727,26 @@ private:
 	/** the maximum size of @a m_dumpFile. */
 	long m_dumpRawMaxSize;
 
-	/** the @a ofstream for dumping raw data to. */
-	ofstream m_dumpRawStream;
+	/** whether to dump in capture format with timing and sent bytes. */
+	bool m_dumpRawCapture;
+
+	/** the @a DumpWriter for dumping raw data, or NULL (guarded by @a m_dumpRawMutex). */
+	DumpWriter* m_dumpRawWriter;
+
+	/** the number of raw bytes dropped by the @a DumpWriter (guarded by @a m_dumpRawMutex). */
+	unsigned long m_dumpRawDropped;
+
+	/** mutex for replacing @a m_dumpRawWriter while another thread is sending or receiving */
+	pthread_mutex_t m_dumpRawMutex;
+
+	/**
+	 * @brief pass raw data to the @a DumpWriter if dumping is enabled.
+	 * @param data the data to dump.
+	 * @param count the number of bytes in @a data.
+	 * @param sent whether the data was sent instead of received.
+	 * @param time the monotonic time [us] the data was received from or sent to the device.
+	 */
+	void dumpRaw(const unsigned char* data, size_t count, const bool sent, const unsigned long long time);
 
 	/**
 	 * @brief internal setter for device type.
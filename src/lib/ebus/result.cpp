@@ -46,6 +46,7 @@ const char* getResultCode(result_t resultCode) {
 	case RESULT_ERR_CRC:          return "ERR: CRC error";
 	case RESULT_ERR_ACK:          return "ERR: ACK error";
 	case RESULT_ERR_NAK:          return "ERR: NAK received";
+	case RESULT_ERR_OVERFLOW:     return "ERR: overflow";
 	default:
 		if (resultCode >= 0)
 			return "success: unknown result code";
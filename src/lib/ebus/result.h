@@ -46,6 +46,7 @@ static const int RESULT_ERR_BUS_LOST = -16;     // arbitration lost
 static const int RESULT_ERR_CRC = -17;          // CRC error
 static const int RESULT_ERR_ACK = -18;          // ACK error
 static const int RESULT_ERR_NAK = -19;          // NAK received
+static const int RESULT_ERR_OVERFLOW = -20;     // data does not fit into the available space
 
 /** type for result code. */
 typedef int result_t;
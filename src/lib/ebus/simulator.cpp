@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "simulator.h"
+#include "capture.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+/** the identification data answered by simulated slaves (manufacturer, ID "SIMUL", SW and HW version). */
+static const unsigned char IDENTIFICATION[] = { 0x0a, 0x00, 'S', 'I', 'M', 'U', 'L', 0x01, 0x00, 0x01, 0x00 };
+
+Simulator::Simulator(const int fd, MessageMap* messages, const long symbolDuration, const unsigned int seed)
+	: m_fd(fd), m_messages(messages), m_symbolDuration(symbolDuration), m_seed(seed),
+	  m_nakRate(0), m_crcRate(0), m_state(ss_idle), m_scriptState(ss_idle),
+	  m_idleSlots(0), m_lastSymbol(ESC), m_repeat(false)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void Simulator::addMaster(const unsigned char address, const unsigned int interval)
+{
+	SimMaster master;
+	master.address = address;
+	master.interval = interval;
+	master.due = 0;
+	m_masters.push_back(master);
+}
+
+void Simulator::run()
+{
+	int flags = fcntl(m_fd, F_GETFL);
+	if (flags >= 0)
+		fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+
+	unsigned long long next = getMonotonicTime();
+	for (vector<SimMaster>::iterator it = m_masters.begin(); it != m_masters.end(); it++)
+		schedule(*it, next);
+
+	while (isRunning() == true) {
+		unsigned long long now = getMonotonicTime();
+		if (now < next) {
+			struct timespec delay;
+			delay.tv_sec = (next - now) / 1000000;
+			delay.tv_nsec = (next - now) % 1000000 * 1000;
+			nanosleep(&delay, NULL);
+			now = next;
+		}
+		else if (now - next > (unsigned long long)SIM_MAX_LAG * m_symbolDuration)
+			next = now; // way behind schedule, e.g. after suspend
+
+		handleSlot(now);
+		next += m_symbolDuration;
+	}
+}
+
+void Simulator::handleSlot(const unsigned long long now)
+{
+	// fetch all symbols sent by the client in the meantime
+	unsigned char buffer[256];
+	ssize_t count;
+	while ((count = read(m_fd, buffer, sizeof(buffer))) > 0)
+		m_clientSymbols.insert(m_clientSymbols.end(), buffer, buffer + count);
+	if (count == 0) {
+		stop(); // client closed the connection
+		return;
+	}
+
+	if (m_script.empty() == false) {
+		unsigned char symbol = m_script.front();
+		m_script.pop_front();
+		if (m_clientSymbols.empty() == false) {
+			// wire AND of both senders
+			symbol &= m_clientSymbols.front();
+			m_clientSymbols.pop_front();
+			m_stats.collisions++;
+		}
+		emit(symbol);
+		if (m_script.empty() == true)
+			m_state = m_scriptState;
+		return;
+	}
+
+	if (m_state != ss_idle) {
+		if (m_clientSymbols.empty() == true) {
+			if (++m_idleSlots >= SIM_SYN_INTERVAL) {
+				// client did not continue
+				emit(SYN);
+				m_stats.syns++;
+				m_state = ss_idle;
+			}
+			return;
+		}
+		unsigned char symbol = m_clientSymbols.front();
+		m_clientSymbols.pop_front();
+		emit(symbol);
+		handleClientSymbol(symbol);
+		return;
+	}
+
+	// masters may only start directly after SYN, the client is given some more time for latency
+	bool afterSyn = m_lastSymbol == SYN;
+	vector<SimMaster*> contenders;
+	if (afterSyn == true && m_idleSlots == 0) {
+		for (vector<SimMaster>::iterator it = m_masters.begin(); it != m_masters.end(); it++)
+			if (it->due <= now)
+				contenders.push_back(&*it);
+	}
+	bool client = m_clientSymbols.empty() == false;
+	if (client == false && contenders.empty() == true) {
+		if (++m_idleSlots >= SIM_SYN_INTERVAL) {
+			emit(SYN);
+			m_stats.syns++;
+		}
+		return;
+	}
+
+	unsigned char clientSymbol = SYN;
+	if (client == true) {
+		clientSymbol = m_clientSymbols.front();
+		m_clientSymbols.pop_front();
+		if (afterSyn == false) {
+			emit(clientSymbol); // not allowed to start a telegram here
+			return;
+		}
+	}
+
+	// bitwise arbitration: a dominant zero bit overrides a recessive one bit, the
+	// sender of the latter withdraws, so the remaining sender determines the symbol
+	bool clientActive = client;
+	unsigned char winner = 0;
+	for (unsigned char bit = 0x01; bit != 0; bit <<= 1) {
+		bool dominant = clientActive == true && (clientSymbol & bit) == 0;
+		for (vector<SimMaster*>::iterator it = contenders.begin(); it != contenders.end(); it++)
+			if (*it != NULL && ((*it)->address & bit) == 0)
+				dominant = true;
+		if (dominant == false) {
+			winner |= bit;
+			continue;
+		}
+		if (clientActive == true && (clientSymbol & bit) != 0)
+			clientActive = false;
+		for (vector<SimMaster*>::iterator it = contenders.begin(); it != contenders.end(); it++)
+			if (*it != NULL && ((*it)->address & bit) != 0)
+				*it = NULL;
+	}
+	emit(winner);
+
+	if (clientActive == true) {
+		m_stats.clientTelegrams++;
+		m_command.clear();
+		m_command.push_back(winner, false);
+		m_repeat = false;
+		m_state = ss_clientCmd;
+		return;
+	}
+	if (client == true)
+		m_stats.clientLost++;
+
+	for (vector<SimMaster*>::iterator it = contenders.begin(); it != contenders.end(); it++)
+		if (*it != NULL) {
+			startMaster(**it);
+			schedule(**it, now);
+			break;
+		}
+}
+
+void Simulator::emit(const unsigned char symbol)
+{
+	if (write(m_fd, &symbol, 1) < 0 && errno != EAGAIN && errno != EIO)
+		stop();
+
+	m_lastSymbol = symbol;
+	m_idleSlots = 0;
+	m_stats.symbols++;
+}
+
+void Simulator::handleClientSymbol(const unsigned char symbol)
+{
+	if (symbol == SYN) {
+		m_state = ss_idle; // bus released by the client
+		return;
+	}
+
+	switch (m_state)
+	{
+	case ss_clientCmd:
+	{
+		result_t result;
+		unsigned char crcPos = m_command.size() > 4 ? 5 + m_command[4] : 0xff;
+		if (m_command.size() == 0)
+			result = m_command.push_back(symbol, false); // repetition after NAK
+		else
+			result = m_command.push_back(symbol, true, m_command.size() < crcPos);
+		if (result < RESULT_OK) {
+			m_state = ss_clientSyn;
+			return;
+		}
+		if (result != RESULT_OK || crcPos == 0xff || m_command.size() != crcPos + 1)
+			return; // command not yet complete
+
+		unsigned char dstAddress = m_command[1];
+		SymbolString response;
+		if (dstAddress == BROADCAST || prepareAnswer(m_command, response) == false) {
+			m_state = ss_clientSyn; // nobody acknowledges
+			return;
+		}
+		bool crcValid = m_command[crcPos] == m_command.getCRC();
+		if (crcValid == false || chance(m_nakRate) == true) {
+			if (crcValid == true)
+				m_stats.naks++;
+			m_script.push_back(NAK);
+			if (m_repeat == false) {
+				m_repeat = true;
+				m_command.clear();
+				m_scriptState = ss_clientCmd;
+			}
+			else
+				m_scriptState = ss_clientSyn;
+			return;
+		}
+
+		m_script.push_back(ACK);
+		m_stats.answered++;
+		if (isMaster(dstAddress) == true) {
+			m_scriptState = ss_clientSyn;
+			return;
+		}
+		m_response = response;
+		m_repeat = false;
+		bool wrongCrc = chance(m_crcRate);
+		if (wrongCrc == true)
+			m_stats.crcErrors++;
+		appendScript(m_response, wrongCrc);
+		m_scriptState = ss_clientAck;
+		return;
+	}
+	case ss_clientAck:
+		if (symbol == NAK && m_repeat == false) {
+			m_repeat = true;
+			appendScript(m_response);
+			m_scriptState = ss_clientAck;
+		}
+		else
+			m_state = ss_clientSyn;
+		return;
+
+	default:
+		return;
+	}
+}
+
+void Simulator::startMaster(SimMaster& master)
+{
+	m_stats.masterTelegrams++;
+
+	SymbolString command;
+	command.push_back(master.address, false, false);
+	if (m_slaves.empty() == true) {
+		command.push_back(BROADCAST, false, false);
+		command.push_back(0x07, false, false); // inquiry of existence
+		command.push_back(0xfe, false, false);
+	}
+	else {
+		command.push_back(m_slaves[rand_r(&m_seed) % m_slaves.size()], false, false);
+		command.push_back(0x07, false, false); // identification
+		command.push_back(0x04, false, false);
+	}
+	command.push_back(0x00, false, false);
+
+	// the address was already put on the bus during arbitration
+	SymbolString escaped(command, true);
+	for (size_t pos = 1; pos < escaped.size(); pos++)
+		m_script.push_back(escaped[pos]);
+	m_scriptState = ss_idle;
+
+	SymbolString response;
+	if (command[1] == BROADCAST || prepareAnswer(command, response) == false) {
+		m_script.push_back(SYN);
+		return;
+	}
+	if (chance(m_nakRate) == true) {
+		m_stats.naks++;
+		m_script.push_back(NAK);
+		appendScript(command);
+	}
+	m_script.push_back(ACK);
+	m_stats.answered++;
+	if (chance(m_crcRate) == true) {
+		m_stats.crcErrors++;
+		appendScript(response, true);
+		m_script.push_back(NAK);
+	}
+	appendScript(response);
+	m_script.push_back(ACK);
+	m_script.push_back(SYN);
+}
+
+bool Simulator::prepareAnswer(SymbolString& command, SymbolString& response)
+{
+	unsigned char dstAddress = command[1];
+	for (vector<SimMaster>::iterator it = m_masters.begin(); it != m_masters.end(); it++)
+		if (it->address == dstAddress)
+			return true; // master-master: ACK only
+
+	bool found = false;
+	for (vector<unsigned char>::iterator it = m_slaves.begin(); it != m_slaves.end(); it++)
+		if (*it == dstAddress)
+			found = true;
+	if (found == false)
+		return false;
+
+	response.clear();
+	if (command[2] == 0x07 && command[3] == 0x04) {
+		for (size_t pos = 0; pos < sizeof(IDENTIFICATION); pos++)
+			response.push_back(IDENTIFICATION[pos], false, false);
+		return true;
+	}
+
+	Message* message = m_messages == NULL ? NULL : m_messages->find(command, true);
+	if (message == NULL)
+		return false;
+
+	unsigned char length = message->getLength(pt_slaveData);
+	response.push_back(length, false, false);
+	for (unsigned char pos = 0; pos < length; pos++)
+		response.push_back(0x00, false, false);
+	return true;
+}
+
+void Simulator::appendScript(const SymbolString& part, const bool wrongCrc)
+{
+	SymbolString escaped(part, true, false);
+	for (size_t pos = 0; pos < escaped.size(); pos++)
+		m_script.push_back(escaped[pos]);
+
+	unsigned char crc = escaped.calcCrc(0, escaped.size());
+	if (wrongCrc == true)
+		crc ^= 0xff;
+	if (crc == ESC) {
+		m_script.push_back(ESC);
+		m_script.push_back(0x00);
+	}
+	else if (crc == SYN) {
+		m_script.push_back(ESC);
+		m_script.push_back(0x01);
+	}
+	else
+		m_script.push_back(crc);
+}
+
+bool Simulator::chance(const float rate)
+{
+	return rate > 0 && rand_r(&m_seed) < rate * RAND_MAX;
+}
+
+void Simulator::schedule(SimMaster& master, const unsigned long long now)
+{
+	// uniformly distributed around the mean interval
+	master.due = now + (unsigned long long)(rand_r(&m_seed) % (2 * master.interval + 1)) * 1000;
+}
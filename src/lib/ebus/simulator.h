@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef LIBEBUS_SIMULATOR_H_
+#define LIBEBUS_SIMULATOR_H_
+
+#include "symbol.h"
+#include "message.h"
+#include "thread.h"
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+/** \file simulator.h
+ * A simulated eBUS with AUTO-SYN generator, slaves and competing masters that is
+ * served to a single client (e.g. ebusd) over a file descriptor such as the master
+ * side of a pty pair, one end of a socketpair, or an accepted TCP connection.
+ * Each symbol sent by the client is echoed in the next symbol slot, so that the
+ * client sees the bus exactly as it would on a real adapter.
+ */
+
+/** the default duration [us] of a single symbol on the simulated bus (2400Bd). */
+#define SIM_SYMBOL_DURATION 4167
+
+/** the number of symbol slots without traffic after which the AUTO-SYN generator sends SYN. */
+#define SIM_SYN_INTERVAL 10
+
+/** the number of symbol slots the schedule may lag behind before it is reset. */
+#define SIM_MAX_LAG 10
+
+/** the state of the simulated bus. */
+enum SimState {
+	ss_idle,      /*!< no telegram in progress */
+	ss_clientCmd, /*!< receiving the command of the client */
+	ss_clientAck, /*!< waiting for the client to acknowledge the response */
+	ss_clientSyn  /*!< waiting for the client to release the bus with SYN */
+};
+
+/** the statistics of a @a Simulator. */
+struct SimulatorStats {
+	unsigned long symbols;         /*!< the number of symbols put on the bus */
+	unsigned long syns;            /*!< the number of SYN symbols generated by the AUTO-SYN generator */
+	unsigned long clientTelegrams; /*!< the number of telegrams started by the client */
+	unsigned long clientLost;      /*!< the number of arbitrations lost by the client */
+	unsigned long masterTelegrams; /*!< the number of telegrams started by simulated masters */
+	unsigned long answered;        /*!< the number of requests answered by simulated slaves */
+	unsigned long naks;            /*!< the number of injected NAKs */
+	unsigned long crcErrors;       /*!< the number of injected CRC errors */
+	unsigned long collisions;      /*!< the number of client symbols colliding with simulated traffic */
+};
+
+/** a master competing with the client for the bus. */
+struct SimMaster {
+	unsigned char address;  /*!< the master address */
+	unsigned int interval;  /*!< the mean interval [ms] between two telegrams */
+	unsigned long long due; /*!< the monotonic time [us] the next telegram is due */
+};
+
+
+/**
+ * @brief Simulates an eBUS with several participants for a single client.
+ */
+class Simulator : public Thread
+{
+
+public:
+	/**
+	 * @brief constructs a new instance.
+	 * @param fd the file descriptor to serve the bus to (not closed by this instance).
+	 * @param messages the @a MessageMap with the definitions the simulated slaves answer, or NULL.
+	 * @param symbolDuration the duration [us] of a single symbol.
+	 * @param seed the seed for the pseudo random decisions.
+	 */
+	Simulator(const int fd, MessageMap* messages,
+		const long symbolDuration=SIM_SYMBOL_DURATION, const unsigned int seed=1);
+
+	/**
+	 * @brief add a simulated slave.
+	 * It answers identification requests and all read or write messages defined
+	 * in the @a MessageMap for its address with zero data.
+	 * @param address the slave address.
+	 */
+	void addSlave(const unsigned char address) { m_slaves.push_back(address); }
+
+	/**
+	 * @brief add a simulated master that competes with the client for the bus.
+	 * It sends identification requests to random simulated slaves, or inquiry of existence
+	 * broadcasts if there are none.
+	 * @param address the master address.
+	 * @param interval the mean interval [ms] between two telegrams.
+	 */
+	void addMaster(const unsigned char address, const unsigned int interval);
+
+	/**
+	 * @brief set the rates of injected errors.
+	 * @param nakRate the probability [0..1] of a NAK for a command with valid CRC.
+	 * @param crcRate the probability [0..1] of a wrong CRC in a response.
+	 */
+	void setErrorRates(const float nakRate, const float crcRate) { m_nakRate = nakRate; m_crcRate = crcRate; }
+
+	/**
+	 * @brief get the statistics.
+	 * @return the @a SimulatorStats.
+	 */
+	const SimulatorStats& getStats() const { return m_stats; }
+
+	// @copydoc
+	virtual void run();
+
+private:
+	/**
+	 * @brief handle a single symbol slot.
+	 * @param now the current monotonic time [us].
+	 */
+	void handleSlot(const unsigned long long now);
+
+	/**
+	 * @brief put a symbol on the bus (i.e. send it to the client).
+	 * @param symbol the symbol.
+	 */
+	void emit(const unsigned char symbol);
+
+	/**
+	 * @brief handle a symbol sent by the client outside of arbitration.
+	 * @param symbol the symbol.
+	 */
+	void handleClientSymbol(const unsigned char symbol);
+
+	/**
+	 * @brief start the telegram of a simulated master that won the arbitration.
+	 * @param master the @a SimMaster.
+	 */
+	void startMaster(SimMaster& master);
+
+	/**
+	 * @brief prepare the answer of a simulated participant for a command.
+	 * @param command the unescaped command.
+	 * @param response the @a SymbolString in which to store the unescaped response
+	 * (left empty for an answer consisting of ACK only).
+	 * @return true if the command is answered, false if nobody is addressed.
+	 */
+	bool prepareAnswer(SymbolString& command, SymbolString& response);
+
+	/**
+	 * @brief append a telegram part to the script, optionally with wrong CRC.
+	 * @param part the unescaped part.
+	 * @param wrongCrc whether to append a wrong CRC.
+	 */
+	void appendScript(const SymbolString& part, const bool wrongCrc=false);
+
+	/**
+	 * @brief return whether a random event with the specified probability happens.
+	 * @param rate the probability [0..1].
+	 * @return true if the event happens.
+	 */
+	bool chance(const float rate);
+
+	/**
+	 * @brief calculate the next due time of a @a SimMaster.
+	 * @param master the @a SimMaster.
+	 * @param now the current monotonic time [us].
+	 */
+	void schedule(SimMaster& master, const unsigned long long now);
+
+	/** the file descriptor to serve the bus to. */
+	const int m_fd;
+
+	/** the @a MessageMap with the definitions the simulated slaves answer, or NULL. */
+	MessageMap* m_messages;
+
+	/** the duration [us] of a single symbol. */
+	const long m_symbolDuration;
+
+	/** the state for the pseudo random decisions. */
+	unsigned int m_seed;
+
+	/** the addresses of the simulated slaves. */
+	vector<unsigned char> m_slaves;
+
+	/** the simulated masters. */
+	vector<SimMaster> m_masters;
+
+	/** the probability [0..1] of a NAK for a command with valid CRC. */
+	float m_nakRate;
+
+	/** the probability [0..1] of a wrong CRC in a response. */
+	float m_crcRate;
+
+	/** the current @a SimState. */
+	SimState m_state;
+
+	/** the symbols received from the client not yet put on the bus. */
+	deque<unsigned char> m_clientSymbols;
+
+	/** the symbols of simulated participants to put on the bus in the next slots. */
+	deque<unsigned char> m_script;
+
+	/** the @a SimState to switch to after @a m_script was put on the bus. */
+	SimState m_scriptState;
+
+	/** the number of slots since the last symbol on the bus. */
+	unsigned int m_idleSlots;
+
+	/** the last symbol on the bus. */
+	unsigned char m_lastSymbol;
+
+	/** the unescaped command received from the client. */
+	SymbolString m_command;
+
+	/** the unescaped response to the command of the client. */
+	SymbolString m_response;
+
+	/** whether the current part of the client telegram is being repeated. */
+	bool m_repeat;
+
+	/** the statistics. */
+	SimulatorStats m_stats;
+
+};
+
+#endif // LIBEBUS_SIMULATOR_H_
@@ -17,11 +17,20 @@
  * along with ebusd. If not, see http://www.gnu.org/licenses/.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include "symbol.h"
 #include "result.h"
 #include <iostream>
 #include <iomanip>
 
+#if defined(HAVE_IMMINTRIN_H) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SIMD_ESCAPE
+#endif
+
 using namespace std;
 
 /**
@@ -47,90 +56,430 @@ static const unsigned char CRC_LOOKUP_TABLE[] =
 	0x95, 0x0e, 0x38, 0xa3, 0x54, 0xcf, 0xf9, 0x62, 0x8c, 0x17, 0x21, 0xba, 0x4d, 0xd6, 0xe0, 0x7b,
 };
 
+/**
+ * @brief CRC8 lookup tables for slicing-by-8, CRC_SLICE_TABLE[n] is @a CRC_LOOKUP_TABLE applied n+2 times.
+ */
+static unsigned char CRC_SLICE_TABLE[7][256];
+
+/**
+ * @brief Calculate the slicing-by-8 tables from @a CRC_LOOKUP_TABLE.
+ * @return true.
+ */
+static bool initCrcSliceTable()
+{
+	for (unsigned int value = 0; value < 256; value++) {
+		unsigned char crc = CRC_LOOKUP_TABLE[value];
+		for (size_t n = 0; n < 7; n++) {
+			crc = CRC_LOOKUP_TABLE[crc];
+			CRC_SLICE_TABLE[n][value] = crc;
+		}
+	}
+	return true;
+}
+
+/** whether the slicing-by-8 tables were calculated (done during static initialization). */
+static const bool crcSliceTableInitialized = initCrcSliceTable();
+
+/**
+ * @brief Update the CRC with a run of symbols not needing any escape handling, 8 symbols at a time.
+ * @param data the symbols to add.
+ * @param count the number of symbols to add.
+ * @param crc the CRC to update.
+ * @return the updated CRC.
+ */
+static unsigned char addCrcRun(const unsigned char* data, size_t count, unsigned char crc)
+{
+	for (; count >= 8; data += 8, count -= 8) {
+		crc = CRC_SLICE_TABLE[6][crc] ^ CRC_SLICE_TABLE[5][data[0]]
+			^ CRC_SLICE_TABLE[4][data[1]] ^ CRC_SLICE_TABLE[3][data[2]]
+			^ CRC_SLICE_TABLE[2][data[3]] ^ CRC_SLICE_TABLE[1][data[4]]
+			^ CRC_SLICE_TABLE[0][data[5]] ^ CRC_LOOKUP_TABLE[data[6]] ^ data[7];
+	}
+	while (count-- > 0)
+		crc = CRC_LOOKUP_TABLE[crc] ^ *data++;
+
+	return crc;
+}
+
+unsigned char calcCrc(const unsigned char* data, size_t count, const bool isEscaped, unsigned char crc)
+{
+	if (isEscaped == true)
+		return addCrcRun(data, count, crc);
+
+	const unsigned char* end = data + count;
+	while (data < end) {
+		const unsigned char* pos = data;
+		while (pos < end && *pos != ESC && *pos != SYN)
+			pos++;
+		crc = addCrcRun(data, pos - data, crc);
+		if (pos == end)
+			break;
+		// escape sequence: ESC followed by 0x00 for ESC or 0x01 for SYN
+		crc = CRC_LOOKUP_TABLE[CRC_LOOKUP_TABLE[crc] ^ ESC] ^ (*pos == ESC ? 0x00 : 0x01);
+		data = pos + 1;
+	}
+
+	return crc;
+}
+
+
+/**
+ * @brief Find the first symbol that is either @a ESC or @a SYN (scalar version).
+ * @param data the symbols to search.
+ * @param count the number of symbols in @a data.
+ * @return the index of the first @a ESC or @a SYN symbol, or @a count if there is none.
+ */
+static size_t findEscapeScalar(const unsigned char* data, size_t count)
+{
+	size_t pos = 0;
+	while (pos < count && data[pos] != ESC && data[pos] != SYN)
+		pos++;
+	return pos;
+}
+
+#ifdef HAVE_SIMD_ESCAPE
+/**
+ * @brief Find the first symbol that is either @a ESC or @a SYN (SSE2 version checking 16 symbols at once).
+ * @param data the symbols to search.
+ * @param count the number of symbols in @a data.
+ * @return the index of the first @a ESC or @a SYN symbol, or @a count if there is none.
+ */
+__attribute__((target("sse2")))
+static size_t findEscapeSse2(const unsigned char* data, size_t count)
+{
+	const __m128i esc = _mm_set1_epi8((char)ESC);
+	const __m128i syn = _mm_set1_epi8((char)SYN);
+	size_t pos = 0;
+	for (; pos + 16 <= count; pos += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + pos));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, esc), _mm_cmpeq_epi8(block, syn)));
+		if (mask != 0)
+			return pos + __builtin_ctz(mask);
+	}
+	return pos + findEscapeScalar(data + pos, count - pos);
+}
+
+/**
+ * @brief Find the first symbol that is either @a ESC or @a SYN (AVX2 version checking 32 symbols at once).
+ * @param data the symbols to search.
+ * @param count the number of symbols in @a data.
+ * @return the index of the first @a ESC or @a SYN symbol, or @a count if there is none.
+ */
+__attribute__((target("avx2")))
+static size_t findEscapeAvx2(const unsigned char* data, size_t count)
+{
+	const __m256i esc = _mm256_set1_epi8((char)ESC);
+	const __m256i syn = _mm256_set1_epi8((char)SYN);
+	size_t pos = 0;
+	for (; pos + 32 <= count; pos += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*)(data + pos));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, esc), _mm256_cmpeq_epi8(block, syn)));
+		if (mask != 0)
+			return pos + __builtin_ctz(mask);
+	}
+	return pos + findEscapeSse2(data + pos, count - pos);
+}
+#endif
+
+/**
+ * @brief Select the fastest variant for finding escape sites supported by the CPU.
+ * @return the function for finding the first @a ESC or @a SYN symbol.
+ */
+static size_t (*selectFindEscape())(const unsigned char*, size_t)
+{
+#ifdef HAVE_SIMD_ESCAPE
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return findEscapeAvx2;
+	if (__builtin_cpu_supports("sse2"))
+		return findEscapeSse2;
+#endif
+	return findEscapeScalar;
+}
+
+/** the function for finding the first @a ESC or @a SYN symbol, selected during static initialization. */
+static size_t (*const findEscape)(const unsigned char*, size_t) = selectFindEscape();
+
+/** the lower case hex digits of all symbols. */
+static char HEX_DIGITS[256][2];
+
+/** the value of each hex digit character, or 0xff for characters not being a hex digit. */
+static unsigned char HEX_VALUES[256];
+
+/**
+ * @brief Initialize the hex encode and decode tables.
+ * @return true.
+ */
+static bool initHexTables()
+{
+	static const char digits[] = "0123456789abcdef";
+	for (unsigned int value = 0; value < 256; value++) {
+		HEX_DIGITS[value][0] = digits[value >> 4];
+		HEX_DIGITS[value][1] = digits[value & 0x0f];
+		if (value >= '0' && value <= '9')
+			HEX_VALUES[value] = (unsigned char)(value - '0');
+		else if (value >= 'a' && value <= 'f')
+			HEX_VALUES[value] = (unsigned char)(value - 'a' + 10);
+		else if (value >= 'A' && value <= 'F')
+			HEX_VALUES[value] = (unsigned char)(value - 'A' + 10);
+		else
+			HEX_VALUES[value] = 0xff;
+	}
+	return true;
+}
+
+/** whether the hex tables were initialized. */
+static const bool hexTablesInitialized = initHexTables();
+
+size_t encodeHex(const unsigned char* data, size_t count, char* str)
+{
+	for (size_t i = 0; i < count; i++) {
+		const char* digits = HEX_DIGITS[data[i]];
+		*str++ = digits[0];
+		*str++ = digits[1];
+	}
+	*str = 0;
+	return 2*count;
+}
+
+result_t decodeHex(const char* str, size_t length, unsigned char* data, size_t maxCount, size_t& count)
+{
+	count = 0;
+	if ((length & 1) != 0)
+		return RESULT_ERR_INVALID_ARG;
+	if (length/2 > maxCount)
+		return RESULT_ERR_OVERFLOW;
+	for (size_t i = 0; i < length; i += 2) {
+		unsigned char high = HEX_VALUES[(unsigned char)str[i]];
+		unsigned char low = HEX_VALUES[(unsigned char)str[i+1]];
+		if ((high | low) == 0xff)
+			return RESULT_ERR_INVALID_ARG;
+		data[count++] = (unsigned char)((high << 4) | low);
+	}
+	return RESULT_OK;
+}
+
 
 SymbolString::SymbolString(const string& str) //TODO use a factory method instead
-	: m_unescapeState(0), m_crc(0)
+	: m_size(0), m_unescapeState(0), m_crc(0)
 {
 	// parse + escape
-	for (size_t i = 0; i+1 < str.size(); i += 2) {
-		unsigned long value = strtoul(str.substr(i, 2).c_str(), NULL, 16); // TODO check
-		push_back((unsigned char)value, false, true);
+	if (parseHex(str, false, false) == RESULT_OK) {
+		m_crc = ::calcCrc(m_data, m_size, true);
+		// add CRC + escape
+		push_back(m_crc, false, false);
 	}
-	// add CRC + escape
-	push_back(m_crc, false, false);
 }
 
 SymbolString::SymbolString(const SymbolString& str, const bool escape, const bool addCrc)
-	: m_unescapeState(escape == true ? 0 : 1), m_crc(0)
+	: m_size(0), m_unescapeState(escape == true ? 0 : 1), m_crc(0)
 {
-	for (size_t i = 0; i < str.size(); i++) {
-		push_back(str[i], str.m_unescapeState == 0, true);
-	}
+	append(str.m_data, str.m_size, str.m_unescapeState == 0, false);
+	m_crc = str.calcCrc();
 	if (addCrc == true)
 		// add CRC
 		push_back(m_crc, false, false);
 }
 
 SymbolString::SymbolString(const string& str, bool isEscaped)
-	: m_unescapeState(1), m_crc(0)
+	: m_size(0), m_unescapeState(1), m_crc(0)
 {
 	// parse + optionally unescape
-	for (size_t i = 0; i+1 < str.size(); i += 2) {
-		unsigned long value = strtoul(str.substr(i, 2).c_str(), NULL, 16); // TODO check
-		push_back((unsigned char)value, isEscaped, false);
+	parseHex(str, isEscaped, false);
+}
+
+result_t SymbolString::parseHex(const string& str, const bool isEscaped, const bool updateCRC)
+{
+	unsigned char values[MAX_SYMBOLS];
+	size_t count;
+	result_t result = decodeHex(str.data(), str.length(), values, MAX_SYMBOLS, count);
+	if (result != RESULT_OK)
+		return result;
+
+	unsigned char size = m_size, crc = m_crc;
+	int state = m_unescapeState;
+	result = append(values, count, isEscaped, updateCRC);
+	if (result < RESULT_OK) {
+		// revert to previous content
+		m_size = size;
+		m_unescapeState = state;
+		m_crc = crc;
 	}
+	return result;
 }
 
-const string SymbolString::getDataStr(const bool unescape)
+const string SymbolString::getDataStr(const bool unescape) const
 {
-	stringstream sstr;
-	bool previousEscape = false;
+	char str[2*MAX_SYMBOLS+1];
+	size_t length = getDataStr(str, unescape);
+	return string(str, length);
+}
 
-	for (size_t i = 0; i < m_data.size(); i++) {
+size_t SymbolString::getDataStr(char* str, const bool unescape) const
+{
+	if (m_unescapeState != 0 || unescape == false)
+		return encodeHex(m_data, m_size, str);
+
+	char* pos = str;
+	bool previousEscape = false;
+	for (size_t i = 0; i < m_size; i++) {
 		unsigned char value = m_data[i];
-		if (m_unescapeState == 0 && unescape == true && previousEscape == true) {
+		if (previousEscape == true) {
 			if (value == 0x00)
-				sstr << "a9"; // ESC
+				value = ESC;
 			else if (value == 0x01)
-				sstr << "aa"; // SYN
-			else
-				sstr << "XX"; // invalid escape sequence
-
+				value = SYN;
+			else {
+				*pos++ = 'X'; // invalid escape sequence
+				*pos++ = 'X';
+				previousEscape = false;
+				continue;
+			}
 			previousEscape = false;
 		}
-		else if (m_unescapeState == 0 && unescape == true && value == ESC) {
+		else if (value == ESC) {
 			previousEscape = true; // escape sequence not yet finished
+			continue;
 		}
-		else {
-			sstr << nouppercase << setw(2) << hex
-					<< setfill('0') << static_cast<unsigned>(value);
+		pos += encodeHex(&value, 1, pos);
+	}
+	*pos = 0;
+	return pos - str;
+}
+
+void SymbolString::swap(SymbolString& other)
+{
+	unsigned char count = m_size > other.m_size ? m_size : other.m_size;
+	for (size_t i = 0; i < count; i++) {
+		unsigned char value = m_data[i];
+		m_data[i] = other.m_data[i];
+		other.m_data[i] = value;
+	}
+	count = m_size;
+	m_size = other.m_size;
+	other.m_size = count;
+	int state = m_unescapeState;
+	m_unescapeState = other.m_unescapeState;
+	other.m_unescapeState = state;
+	unsigned char crc = m_crc;
+	m_crc = other.m_crc;
+	other.m_crc = crc;
+}
+
+result_t SymbolString::append(const unsigned char* data, size_t count, const bool isEscaped, const bool updateCRC)
+{
+	if (isEscaped == false && m_unescapeState == 2)
+		return RESULT_ERR_ESC; // invalid unescape state
+
+	if (updateCRC == true)
+		m_crc = ::calcCrc(data, count, isEscaped, m_crc);
+
+	const unsigned char* end = data + count;
+	if (isEscaped == true && m_unescapeState == 2 && data < end) {
+		result_t result = push_back(*data++, true, false); // finish pending escape sequence
+		if (result < RESULT_OK)
+			return result;
+	}
+	if (isEscaped == (m_unescapeState == 0)) {
+		// same representation: plain copy
+		if (m_size + count > MAX_SYMBOLS)
+			return RESULT_ERR_OVERFLOW;
+		memcpy(m_data + m_size, data, count);
+		m_size += count;
+		return RESULT_OK;
+	}
+	while (data < end) {
+		size_t run = findEscape(data, end - data);
+		if (m_size + run > MAX_SYMBOLS)
+			return RESULT_ERR_OVERFLOW;
+		memcpy(m_data + m_size, data, run); // copy symbols not affected by escaping
+		m_size += run;
+		data += run;
+		if (data == end)
+			break;
+
+		if (m_unescapeState == 0) { // expand ESC/SYN to escape sequence
+			if (m_size + 2 > MAX_SYMBOLS)
+				return RESULT_ERR_OVERFLOW;
+			m_data[m_size++] = ESC;
+			m_data[m_size++] = *data++ == ESC ? 0x00 : 0x01;
+		}
+		else if (*data == SYN) { // not escaped, keep as is
+			if (m_size >= MAX_SYMBOLS)
+				return RESULT_ERR_OVERFLOW;
+			m_data[m_size++] = *data++;
+		}
+		else if (data + 1 == end) { // escape sequence continues with next symbol
+			m_unescapeState = 2;
+			return RESULT_IN_ESC;
+		}
+		else if (data[1] == 0x00 || data[1] == 0x01) { // collapse escape sequence
+			if (m_size >= MAX_SYMBOLS)
+				return RESULT_ERR_OVERFLOW;
+			m_data[m_size++] = data[1] == 0x00 ? ESC : SYN;
+			data += 2;
+		}
+		else { // invalid escape sequence: handle the remainder symbol by symbol
+			for (; data < end; data++) {
+				result_t result = push_back(*data, true, false);
+				if (result == RESULT_ERR_OVERFLOW)
+					return result;
+			}
+			return RESULT_ERR_ESC;
 		}
 	}
+	return RESULT_OK;
+}
+
+result_t SymbolString::resize(const size_t size)
+{
+	if (size > MAX_SYMBOLS)
+		return RESULT_ERR_OVERFLOW;
+
+	if (size > m_size)
+		memset(m_data + m_size, 0, size - m_size);
+	m_size = (unsigned char)size;
+	return RESULT_OK;
+}
 
-	return sstr.str();
+result_t SymbolString::assignEscaped(const SymbolString& str, const bool addCrc)
+{
+	m_size = 0;
+	m_unescapeState = 0;
+	m_crc = 0;
+	result_t result = append(str.m_data, str.m_size, false, true); // escape and calculate the CRC at once
+	if (result != RESULT_OK || addCrc == false)
+		return result;
+	return push_back(m_crc, false, false);
 }
 
 result_t SymbolString::push_back(const unsigned char value, const bool isEscaped, const bool updateCRC)
 {
 	if (m_unescapeState == 0) { // store escaped data
 		if (isEscaped == false && value == ESC) {
-			m_data.push_back(ESC);
-			m_data.push_back(0x00);
+			if (m_size + 2 > MAX_SYMBOLS)
+				return RESULT_ERR_OVERFLOW;
+			m_data[m_size++] = ESC;
+			m_data[m_size++] = 0x00;
 			if (updateCRC) {
 				addCRC(ESC);
 				addCRC(0x00);
 			}
 		}
 		else if (isEscaped == false && value == SYN) {
-			m_data.push_back(ESC);
-			m_data.push_back(0x01);
+			if (m_size + 2 > MAX_SYMBOLS)
+				return RESULT_ERR_OVERFLOW;
+			m_data[m_size++] = ESC;
+			m_data[m_size++] = 0x01;
 			if (updateCRC) {
 				addCRC(ESC);
 				addCRC(0x01);
 			}
 		}
 		else {
-			m_data.push_back(value);
+			if (m_size >= MAX_SYMBOLS)
+				return RESULT_ERR_OVERFLOW;
+			m_data[m_size++] = value;
 			if (updateCRC)
 				addCRC(value);
 
@@ -140,7 +489,9 @@ result_t SymbolString::push_back(const unsigned char value, const bool isEscaped
 	else if (isEscaped == false) {
 		if (m_unescapeState != 1)
 			return RESULT_ERR_ESC; // invalid unescape state
-		m_data.push_back(value);
+		if (m_size >= MAX_SYMBOLS)
+			return RESULT_ERR_OVERFLOW;
+		m_data[m_size++] = value;
 		if (updateCRC) {
 			if (value == ESC) {
 				addCRC(ESC);
@@ -157,16 +508,18 @@ result_t SymbolString::push_back(const unsigned char value, const bool isEscaped
 		return RESULT_OK;
 	}
 	else if (m_unescapeState != 1) {
+		if (m_size >= MAX_SYMBOLS)
+			return RESULT_ERR_OVERFLOW;
 		if (updateCRC)
 			addCRC(value);
 
 		if (value == 0x00) {
-			m_data.push_back(ESC);
+			m_data[m_size++] = ESC;
 			m_unescapeState = 1;
 			return RESULT_OK;
 		}
 		if (value == 0x01) {
-			m_data.push_back(SYN);
+			m_data[m_size++] = SYN;
 			m_unescapeState = 1;
 			return RESULT_OK;
 		}
@@ -179,13 +532,24 @@ result_t SymbolString::push_back(const unsigned char value, const bool isEscaped
 		m_unescapeState = 2;
 		return RESULT_IN_ESC;
 	}
+	if (m_size >= MAX_SYMBOLS)
+		return RESULT_ERR_OVERFLOW;
 	if (updateCRC)
 		addCRC(value);
 
-	m_data.push_back(value);
+	m_data[m_size++] = value;
 	return RESULT_OK;
 }
 
+unsigned char SymbolString::calcCrc(const size_t start, size_t count) const
+{
+	if (start >= m_size)
+		return 0;
+	if (count > m_size - start)
+		count = m_size - start;
+	return ::calcCrc(m_data + start, count, m_unescapeState == 0);
+}
+
 void SymbolString::addCRC(const unsigned char value) {
 	m_crc = CRC_LOOKUP_TABLE[m_crc]^value;
 }
@@ -34,9 +34,50 @@ static const unsigned char ACK = 0x00;       // positive acknowledge
 static const unsigned char NAK = 0xFF;       // negative acknowledge
 static const unsigned char BROADCAST = 0xFE; // the broadcast destination address
 
+/** the maximum number of data bytes in a master or slave part (NN). */
+#define MAX_DATA_LENGTH 16
+
+/** the maximum number of symbols in a @a SymbolString (QQ ZZ PB SB NN + data + CRC, each possibly escaped). */
+#define MAX_SYMBOLS (2*(5+MAX_DATA_LENGTH+1))
+
+
+/**
+ * @brief Calculate the CRC of a buffer of bus symbols at once.
+ * @param data the symbols to add to the CRC.
+ * @param count the number of symbols in @a data.
+ * @param isEscaped whether the symbols are escaped, false to account each ESC and SYN
+ * symbol with its escape sequence.
+ * @param crc the CRC to start with.
+ * @return the calculated CRC.
+ */
+unsigned char calcCrc(const unsigned char* data, size_t count, const bool isEscaped=true, unsigned char crc=0);
+
+/**
+ * @brief Encode a buffer of symbols as lower case hex string.
+ * @param data the symbols to encode.
+ * @param count the number of symbols in @a data.
+ * @param str the buffer to write the hex digits and the terminating NUL character to (at least 2*@a count+1 characters).
+ * @return the number of hex digits written.
+ */
+size_t encodeHex(const unsigned char* data, size_t count, char* str);
+
+/**
+ * @brief Decode a hex string to a buffer of symbols.
+ * @param str the upper or lower case hex string.
+ * @param length the number of characters in @a str.
+ * @param data the buffer to write the decoded symbols to.
+ * @param maxCount the maximum number of symbols to write to @a data.
+ * @param count the variable in which to store the number of decoded symbols.
+ * @return RESULT_OK on success, RESULT_ERR_INVALID_ARG if @a str has an odd length or contains
+ * a character that is not a hex digit, or RESULT_ERR_OVERFLOW if the symbols do not fit into @a data.
+ */
+result_t decodeHex(const char* str, size_t length, unsigned char* data, size_t maxCount, size_t& count);
+
 
 /**
  * @brief A string of escaped or unescaped bus symbols.
+ * The symbols are stored inline with a fixed capacity of @a MAX_SYMBOLS, so that
+ * handling a telegram does not need any heap allocation.
  */
 class SymbolString
 {
@@ -45,9 +86,10 @@ public:
 	/**
 	 * @brief Creates a new unescaped empty instance.
 	 */
-	SymbolString() : m_unescapeState(1), m_crc(0) {}
+	SymbolString() : m_size(0), m_unescapeState(1), m_crc(0) {}
 	/**
 	 * @brief Creates a new escaped instance from an unescaped hex string and adds the calculated CRC.
+	 * The instance is left empty if the hex string is invalid.
 	 * @param str the unescaped hex string.
 	 */
 	SymbolString(const string& str);
@@ -58,6 +100,7 @@ public:
 	SymbolString(const SymbolString& str, const bool escape, const bool addCrc=true);
 	/**
 	 * @brief Creates a new unescaped instance from a hex string.
+	 * The instance is left empty if the hex string is invalid.
 	 * @param isEscaped whether the hex string is escaped and shall be unescaped.
 	 * @param str the hex string.
 	 */
@@ -67,13 +110,31 @@ public:
 	 * @param unescape whether to unescape an escaped instance.
 	 * @return the symbols as hex string.
 	 */
-	const string getDataStr(const bool unescape=true);
+	const string getDataStr(const bool unescape=true) const;
+	/**
+	 * @brief Writes the symbols as hex string to the buffer.
+	 * @param str the buffer to write the hex string and the terminating NUL character to
+	 * (at least 2*@a MAX_SYMBOLS+1 characters).
+	 * @param unescape whether to unescape an escaped instance.
+	 * @return the number of hex digits written.
+	 */
+	size_t getDataStr(char* str, const bool unescape=true) const;
+	/**
+	 * @brief Parses a hex string and appends the symbols to the end of the symbol string.
+	 * Nothing is appended if the hex string is invalid or does not fit.
+	 * @param str the hex string.
+	 * @param isEscaped whether the hex string is escaped.
+	 * @param updateCRC whether to update the calculated CRC in @a m_crc.
+	 * @return the result code of @a decodeHex() or @a append().
+	 */
+	result_t parseHex(const string& str, const bool isEscaped=false, const bool updateCRC=true);
 	/**
 	 * @brief Returns a reference to the symbol at the specified index.
-	 * @param index the index of the symbol to return.
+	 * The string is never extended here, use @a resize() or @a push_back() for that.
+	 * @param index the index of the symbol to return (below @a size()).
 	 * @return the reference to the symbol at the specified index.
 	 */
-	unsigned char& operator[](const size_t index) { if (index >= m_data.size()) m_data.resize(index+1, 0); return m_data[index]; }
+	unsigned char& operator[](const size_t index) { return m_data[index]; }
 	/**
 	 * @brief Returns the symbol at the specified index.
 	 * @param index the index of the symbol to return.
@@ -86,19 +147,14 @@ public:
 	 * @return true if this instance is equal to the other instance (i.e. both escaped or both unescaped and same symbols).
 	 */
 	bool operator==(SymbolString& other) {
-		return m_unescapeState==other.m_unescapeState && m_data==other.m_data;
-		/*bool ret = m_unescapeState==other.m_unescapeState && m_data==other.m_data;
-		for (int i=0; i<m_data.size(); i++) {
-			cout<<setw(2)<<setfill('0')<<hex<<static_cast<unsigned>(m_data[i])<<" ";
-		}
-		cout<<"["<<static_cast<unsigned>(m_unescapeState)<<"]";
-		cout<<(ret?" == ":" != ");
-		for (int i=0; i<other.m_data.size(); i++) {
-			cout<<setw(2)<<setfill('0')<<hex<<static_cast<unsigned>(other.m_data[i])<<" ";
-		}
-		cout<<"["<<static_cast<unsigned>(other.m_unescapeState)<<"]"<<endl;
-		return ret;*/
+		return m_unescapeState==other.m_unescapeState && m_size==other.m_size
+			&& memcmp(m_data, other.m_data, m_size)==0;
 	}
+	/**
+	 * @brief Exchanges the content of this instance with the other instance without any allocation.
+	 * @param other the other instance.
+	 */
+	void swap(SymbolString& other);
 	/**
 	 * @brief Appends a the symbol to the end of the symbol string and escapes/unescapes it if necessary.
 	 * @param value the symbol to append.
@@ -106,23 +162,64 @@ public:
 	 * @param updateCrc whether to update the calculated CRC in @a m_crc.
 	 * @return RESULT_OK if another symbol was appended,
 	 * RESULT_IN_ESC if this is an unescaped instance and the symbol is escaped and the start of the escape sequence was received,
-	 * RESULT_ERR_ESC if this is an unescaped instance and an invalid escaped sequence was detected.
+	 * RESULT_ERR_ESC if this is an unescaped instance and an invalid escaped sequence was detected,
+	 * RESULT_ERR_OVERFLOW if the symbol does not fit into the remaining capacity.
 	 */
 	result_t push_back(const unsigned char value, const bool isEscaped=true, const bool updateCRC=true);
+	/**
+	 * @brief Appends a buffer of symbols to the end of the symbol string and escapes/unescapes them if necessary.
+	 * Runs of symbols not affected by escaping are copied at once.
+	 * @param data the symbols to append.
+	 * @param count the number of symbols in @a data.
+	 * @param isEscaped whether the symbols are escaped.
+	 * @param updateCRC whether to update the calculated CRC in @a m_crc.
+	 * @return RESULT_OK if all symbols were appended,
+	 * RESULT_IN_ESC if this is an unescaped instance and the symbols end within an escape sequence,
+	 * RESULT_ERR_ESC if this is an unescaped instance and an invalid escaped sequence was detected
+	 * or unescaped symbols are appended within an escape sequence,
+	 * RESULT_ERR_OVERFLOW if the symbols do not fit into the remaining capacity.
+	 */
+	result_t append(const unsigned char* data, size_t count, const bool isEscaped=true, const bool updateCRC=true);
+	/**
+	 * @brief Replaces the symbols with the escaped symbols of an unescaped instance and
+	 * calculates the CRC in the same pass.
+	 * @param str the unescaped @a SymbolString to escape.
+	 * @param addCrc whether to append the calculated CRC, false to only keep it in @a getCRC() for appending further symbols.
+	 * @return RESULT_OK on success, or RESULT_ERR_OVERFLOW if the escaped symbols do not fit.
+	 */
+	result_t assignEscaped(const SymbolString& str, const bool addCrc=true);
+	/**
+	 * @brief Changes the number of symbols, filling up with zero symbols if necessary.
+	 * @param size the new number of symbols.
+	 * @return RESULT_OK on success, or RESULT_ERR_OVERFLOW if @a size exceeds @a MAX_SYMBOLS.
+	 */
+	result_t resize(const size_t size);
 	/**
 	 * @brief Returns the number of symbols in this symbol string.
 	 * @return the number of available symbols.
 	 */
-	unsigned char size() const { return (unsigned char)m_data.size(); }
+	unsigned char size() const { return m_size; }
 	/**
 	 * @brief Returns the calculated CRC.
 	 * @return the calculated CRC.
 	 */
 	unsigned char getCRC() const { return m_crc; }
+	/**
+	 * @brief Calculates the CRC of a range of the symbols at once.
+	 * @param start the index of the first symbol to include.
+	 * @param count the maximum number of symbols to include.
+	 * @return the CRC calculated over the (escaped) symbols in the range.
+	 */
+	unsigned char calcCrc(const size_t start=0, size_t count=MAX_SYMBOLS) const;
+	/**
+	 * @brief Returns the symbols as buffer.
+	 * @return the pointer to the first of the @a size() symbols.
+	 */
+	const unsigned char* data() const { return m_data; }
 	/**
 	 * @brief Clears the symbols.
 	 */
-	void clear() { m_data.clear(); m_unescapeState = m_unescapeState==0 ? 0 : 1; m_crc = 0; }
+	void clear() { m_size = 0; m_unescapeState = m_unescapeState==0 ? 0 : 1; m_crc = 0; }
 
 private:
 
@@ -131,7 +228,8 @@ private:
 	 * @param str the @a SymbolString to copy from.
 	 */
 	SymbolString(const SymbolString& str)
-		: m_data(str.m_data), m_unescapeState(str.m_unescapeState), m_crc(str.m_crc) {}
+		: m_size(str.m_size), m_unescapeState(str.m_unescapeState), m_crc(str.m_crc)
+	{ memcpy(m_data, str.m_data, m_size); }
 
 	/**
 	 * @brief Updates the calculated CRC in @a m_crc by adding a value.
@@ -142,7 +240,11 @@ private:
 	/**
 	 * @brief the string of bus symbols.
 	 */
-	vector<unsigned char> m_data;
+	unsigned char m_data[MAX_SYMBOLS];
+	/**
+	 * @brief the number of symbols in @a m_data.
+	 */
+	unsigned char m_size;
 	/**
 	 * @brief 0 if the symbols in @a m_data are escaped,
 	 * 1 if the symbols in @a m_data are unescaped and the last symbol passed to @a push_back was a normal symbol,
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "symbol.h"
+#include "data.h"
+#include <iostream>
+#include <iomanip>
+#include <sys/time.h>
+#include <cstdlib>
+#include <math.h>
+
+using namespace std;
+
+/** the number of iterations per benchmark. */
+#define ITERATIONS 200000
+
+/**
+ * @brief Return the current time in microseconds.
+ * @return the current time in microseconds.
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+/**
+ * @brief Print the result of a benchmark comparison.
+ * @param name the name of the benchmark.
+ * @param previous the duration of the previous implementation in microseconds.
+ * @param current the duration of the current implementation in microseconds.
+ */
+static void report(const char* name, double previous, double current)
+{
+	cout << name << ": previous " << fixed << setprecision(1) << previous * 1000 / ITERATIONS
+		<< " ns, current " << current * 1000 / ITERATIONS << " ns, speedup "
+		<< setprecision(2) << previous / current << "x" << endl;
+}
+
+/**
+ * @brief Format symbols the way @a SymbolString::getDataStr() did before using the hex tables.
+ * @param data the symbols to format.
+ * @param count the number of symbols in @a data.
+ * @return the symbols as hex string.
+ */
+static string previousEncode(const unsigned char* data, size_t count)
+{
+	stringstream sstr;
+	for (size_t i = 0; i < count; i++)
+		sstr << nouppercase << setw(2) << hex << setfill('0') << static_cast<unsigned>(data[i]);
+	return sstr.str();
+}
+
+/**
+ * @brief Parse a hex string the way the @a SymbolString constructors did before using the hex tables.
+ * @param str the hex string to parse.
+ * @param data the buffer to write the symbols to.
+ * @return the number of parsed symbols.
+ */
+static size_t previousDecode(const string& str, unsigned char* data)
+{
+	size_t count = 0;
+	for (size_t i = 0; i+1 < str.size(); i += 2)
+		data[count++] = (unsigned char)strtoul(str.substr(i, 2).c_str(), NULL, 16);
+	return count;
+}
+
+/**
+ * @brief Format a number the way @a NumberDataField::readSymbols() did before using @a formatFixed().
+ * @param value the signed binary value.
+ * @param divisor the divisor to apply.
+ * @param precision the number of fraction digits.
+ * @return the formatted number.
+ */
+static string previousFormat(int value, unsigned int divisor, int precision)
+{
+	ostringstream output;
+	output << setprecision(precision) << fixed << static_cast<float>(value / (float) divisor);
+	return output.str();
+}
+
+/**
+ * @brief Parse a number the way @a NumberDataField::writeSymbols() did before using @a parseFixed().
+ * @param str the string to parse.
+ * @param divisor the divisor to apply.
+ * @return the signed binary value.
+ */
+static long long previousParse(const char* str, unsigned int divisor)
+{
+	char* strEnd = NULL;
+	double dvalue = strtod(str, &strEnd);
+	return (long long)round(dvalue * divisor);
+}
+
+int main()
+{
+	const string hexStr = "1008b5100902000a0300000000000000000000";
+	unsigned char data[MAX_SYMBOLS];
+	size_t count = 0;
+	if (decodeHex(hexStr.data(), hexStr.length(), data, MAX_SYMBOLS, count) != RESULT_OK
+	|| previousDecode(hexStr, data) != count || previousEncode(data, count) != hexStr) {
+		cout << "hex error: mismatch" << endl;
+		return 1;
+	}
+
+	size_t sum = 0;
+	double start = now();
+	for (int i = 0; i < ITERATIONS; i++)
+		sum += previousEncode(data, count).length();
+	double previous = now() - start;
+	char str[2*MAX_SYMBOLS+1];
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++)
+		sum += encodeHex(data, count, str);
+	report("hex encode", previous, now() - start);
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++)
+		sum += previousDecode(hexStr, data);
+	previous = now() - start;
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		decodeHex(hexStr.data(), hexStr.length(), data, MAX_SYMBOLS, count);
+		sum += count;
+	}
+	report("hex decode", previous, now() - start);
+
+	string defs = "a,s,d2c,,,,b,s,d2b,,,,c,s,uin,10,,,d,s,uch,0=off;1=on;2=auto,,,e,s,bi0,,,,f,s,bi1:3,,,,g,s,sch";
+	istringstream defStream(defs);
+	vector<string> entries;
+	string item;
+	while (getline(defStream, item, FIELD_SEPARATOR) != 0)
+		entries.push_back(item);
+	vector<string>::iterator it = entries.begin();
+	DataField* fields = NULL;
+	if (DataField::create(it, entries.end(), NULL, fields, false, 0x08) != RESULT_OK) {
+		cout << "decode error: create" << endl;
+		return 1;
+	}
+	DecodeProgram program;
+	program.compile(fields, pt_slaveData, 0);
+	SymbolString slave("0a2001120210000282a6", false);
+	ostringstream previousOutput, currentOutput;
+	fields->read(pt_slaveData, slave, 0, previousOutput);
+	program.run(slave, currentOutput);
+	if (previousOutput.str() != currentOutput.str()) {
+		cout << "decode error: mismatch " << previousOutput.str() << " " << currentOutput.str() << endl;
+		return 1;
+	}
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ostringstream output;
+		fields->read(pt_slaveData, slave, 0, output);
+		sum += output.tellp();
+	}
+	previous = now() - start;
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ostringstream output;
+		program.run(slave, output);
+		sum += output.tellp();
+	}
+	report("decode", previous, now() - start);
+	fields->release();
+
+	// D2C and D2B values in the whole range
+	char buffer[MAX_NUMBER_LENGTH];
+	for (int value = -32767; value <= 32767; value++) {
+		formatFixed(value, 16, 2, buffer);
+		string expect = previousFormat(value, 16, 2);
+		if (expect != buffer) {
+			cout << "number error: mismatch " << expect << " " << buffer << endl;
+			return 1;
+		}
+		long long parsed;
+		if (parseFixed(buffer, 16, parsed) != RESULT_OK || parsed != previousParse(buffer, 16)) {
+			cout << "number error: parse mismatch " << buffer << endl;
+			return 1;
+		}
+		formatFixed(value, 256, 3, buffer);
+		expect = previousFormat(value, 256, 3);
+		if (expect != buffer) {
+			cout << "number error: mismatch " << expect << " " << buffer << endl;
+			return 1;
+		}
+	}
+
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++)
+		sum += previousFormat(i % 65535 - 32767, 256, 3).length();
+	previous = now() - start;
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++)
+		sum += formatFixed(i % 65535 - 32767, 256, 3, buffer);
+	report("number format", previous, now() - start);
+
+	const char* numberStr = "-127.996";
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++)
+		sum += previousParse(numberStr, 256);
+	previous = now() - start;
+	start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		long long parsed;
+		parseFixed(numberStr, 256, parsed);
+		sum += parsed;
+	}
+	report("number parse", previous, now() - start);
+
+	return sum == 0 ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "capture.h"
+#include "port.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+/** the number of records to write. */
+#define RECORDS 2000
+
+int main()
+{
+	const char* fileName = "test_capture.bin";
+	unsigned char out[CAPTURE_MAX_ENCODED];
+	unsigned long long times[RECORDS];
+	size_t counts[RECORDS];
+
+	CaptureEncoder encoder;
+	ofstream stream(fileName, ios::out | ios::binary | ios::trunc);
+	stream.write((char*)out, encoder.begin(out));
+
+	srand(1);
+	unsigned long long time = getMonotonicTime();
+	for (int i = 0; i < RECORDS; i++) {
+		unsigned char data[CAPTURE_MAX_RECORD];
+		counts[i] = 1 + rand() % (i % 50 == 0 ? CAPTURE_MAX_RECORD : 4);
+		for (size_t pos = 0; pos < counts[i]; pos++)
+			data[pos] = (unsigned char)(i + pos);
+		time += rand() % 5000;
+		times[i] = time;
+		stream.write((char*)out, encoder.encode(time, i % 3 == 0, data, counts[i], out));
+	}
+	stream.close();
+
+	CaptureReader reader;
+	result_t result = reader.open(fileName);
+	if (result != RESULT_OK) {
+		cout << "open error: " << getResultCode(result) << endl;
+		return 1;
+	}
+
+	bool match = true;
+	int records = 0;
+	unsigned long long gotTime;
+	bool sent;
+	unsigned char data[CAPTURE_MAX_RECORD];
+	size_t count;
+	while (match == true && reader.next(gotTime, sent, data, count) == RESULT_OK) {
+		match = records < RECORDS && gotTime == times[records] && sent == (records % 3 == 0)
+			&& count == counts[records] && data[count-1] == (unsigned char)(records + count - 1);
+		records++;
+	}
+	if (match == true && records == RECORDS)
+		cout << "read OK" << endl;
+	else
+		cout << "read error: record " << records << endl;
+
+	int index = RECORDS * 3 / 4;
+	reader.seek(times[index]);
+	do {
+		result = reader.next(gotTime, sent, data, count);
+	} while (result == RESULT_OK && gotTime < times[index]);
+	if (result == RESULT_OK && gotTime == times[index] && count == counts[index])
+		cout << "seek OK" << endl;
+	else
+		cout << "seek error: " << getResultCode(result) << endl;
+
+	reader.close();
+
+	// replay of received symbols as fast as possible
+	size_t expected = 0;
+	for (int i = 0; i < RECORDS; i++)
+		if (i % 3 != 0)
+			expected += counts[i];
+	Port port(string(REPLAY_PREFIX) + fileName, false, false, NULL, false, "", 0, false, 0);
+	port.open();
+	size_t received = 0;
+	ssize_t got;
+	while ((got = port.recv(0, sizeof(data), data)) > 0)
+		received += got;
+	if (got == RESULT_ERR_EOF && received == expected && port.isOpen() == false)
+		cout << "replay OK" << endl;
+	else
+		cout << "replay error: " << received << " of " << expected << endl;
+
+	// plain dump file
+	stream.open(fileName, ios::out | ios::binary | ios::trunc);
+	stream.write((char*)times, sizeof(times));
+	stream.close();
+	result = reader.open(fileName);
+	remove(fileName);
+	if (result == RESULT_ERR_INVALID_ARG)
+		cout << "invalid OK" << endl;
+	else
+		cout << "invalid error: " << getResultCode(result) << endl;
+
+	return 0;
+}
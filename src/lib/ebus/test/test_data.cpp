@@ -146,6 +146,9 @@ int main()
 		{"x,,d2c", "-",      "10feffff020080", "00", ""},
 		{"x,,d2c","-2047.94","10feffff020180", "00", ""},
 		{"x,,d2c", "2047.94","10feffff02ff7f", "00", ""},
+		{"x,,d2b", "0.062",  "10feffff021000", "00", ""},
+		{"x,,ulg,10","429496728", "10feffff04f0ffffff", "00", ""},
+		{"x,,slg,10","-1",        "10feffff04f6ffffff", "00", ""},
 		{"x,,ulg", "38",         "10feffff0426000000", "00", ""},
 		{"x,,ulg", "0",          "10feffff0400000000", "00", ""},
 		{"x,,ulg", "4294967294", "10feffff04feffffff", "00", ""},
@@ -167,6 +170,8 @@ int main()
 		{"x,,bi3:2,0=off;1=on","on", "10feffff0108", "00", ""},
 		{"x,,bi3:2,0=off;1=on","off","10feffff0100", "00", ""},
 		{"x,,uch,1=test;2=high;3=off;4=on","on","10feffff0104", "00", ""},
+		{"x,,uin,1=low;1000=high;2000=max","high","10feffff02e803", "00", ""},
+		{"x,,uin,1=low;1000=high;2000=max","","10feffff02e903", "00", "rw"},
 		{"x,s,uch","3","1050ffff00", "0103", ""},
 		{"x,,d2b,,°C,Aussentemperatur","x=18.004 °C [Aussentemperatur]","10fe0700090112", "00", "v"},
 		{"x,,bti,,,,y,,bda,,,,z,,bdy", "21:04:58;26.10.2014;Sun","10fe0700085804212610061406", "00", ""}, // combination
@@ -176,6 +181,7 @@ int main()
 		{"x,,bi3,,,,y,,bi5", "-;-",            "10feffff0100", "00", ""}, // bit combination
 		{"x,,bi3,,,,y,,bi7,,,,t,,uch", "-;-;9","10feffff020009", "00", ""}, // bit combination
 		{"x,,bi6:2,,,,y,,bi0:2,,,,t,,uch", "2;1;9","10feffff03800109", "00", ""}, // bit combination
+		{"x,,bi0,,,,y,,bi1,0=off;1=on,,,z,,bi2:3,,,,w,,bi7,,,,t,,uch", "1;on;5;1;9","10feffff029709", "00", ""}, // bit combination
 		{"temp,,d2b,,°C,Aussentemperatur","","", "", "t"}, // template with relative pos
 		{"x,,temp","18.004","10fe0700020112", "00", ""}, // reference to template
 		{"relrel,,d2b,,,,y,,d1c","","", "", "t"},   // template struct with relative pos
@@ -208,7 +214,7 @@ int main()
 			entries.push_back(item);
 
 		if (fields != NULL) {
-			delete fields;
+			fields->release();
 			fields = NULL;
 		}
 		vector<string>::iterator it = entries.begin();
@@ -270,7 +276,39 @@ int main()
 		}
 
 		if (verbose == false) {
-			istringstream input(expectStr);
+			// the compiled program has to read the same as the fields
+			DecodeProgram masterProgram, slaveProgram;
+			masterProgram.compile(fields, pt_masterData, 0);
+			slaveProgram.compile(fields, pt_slaveData, 0);
+			ostringstream compiled;
+			result_t compiledResult = masterProgram.run(mstr, compiled);
+			if (compiledResult == RESULT_OK)
+				compiledResult = slaveProgram.run(sstr, compiled, compiled.str().empty() == false);
+			if (compiledResult != result)
+				cout << "  compiled read " << fields->getName() << " >" << check[2]
+				        << "< error: got " << getResultCode(compiledResult) << ", expected " << getResultCode(result) << endl;
+			else
+				verify(false, "compiled read", check[2], compiled.str() == output.str(), output.str(), compiled.str());
+
+			// the typed values have to format the same as the fields (no partial output on error)
+			DecodedValues masterValues, slaveValues;
+			ostringstream typed;
+			result_t typedResult = masterProgram.decode(mstr, masterValues);
+			if (typedResult == RESULT_OK)
+				typedResult = masterValues.format(typed);
+			if (typedResult == RESULT_OK)
+				typedResult = slaveProgram.decode(sstr, slaveValues);
+			if (typedResult == RESULT_OK)
+				typedResult = slaveValues.format(typed, typed.str().empty() == false);
+			if (typedResult != result)
+				cout << "  typed read " << fields->getName() << " >" << check[2]
+				        << "< error: got " << getResultCode(typedResult) << ", expected " << getResultCode(result) << endl;
+			else
+				verify(false, "typed read", check[2], result != RESULT_OK || typed.str() == output.str(), output.str(), typed.str());
+		}
+
+		if (verbose == false) {
+			StringView input(expectStr);
 			result = fields->write(input, pt_masterData, writeMstr, 0);
 			if (result == RESULT_OK)
 				result = fields->write(input, pt_slaveData, writeSstr, 0);
@@ -291,12 +329,22 @@ int main()
 				verify(failedWriteMatch, "write", expectStr, match, mstr.getDataStr() + " " + sstr.getDataStr(), writeMstr.getDataStr() + " " + writeSstr.getDataStr());
 			}
 		}
-		delete fields;
+		fields->release();
 		fields = NULL;
 	}
 
 	delete templates;
 
+	// equal strings share a single pooled instance
+	string name = "pooled";
+	const string& first = StringPool::intern(name);
+	const string& second = StringPool::intern(string("pool") + "ed");
+	const string& other = StringPool::intern("other");
+	if (&first == &second && first == name && &other != &first)
+		cout << "string pool OK" << endl;
+	else
+		cout << "string pool error" << endl;
+
 	return 0;
 
 }
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <cstdio>
 
 using namespace std;
 
@@ -41,6 +42,72 @@ void verify(bool expectFailMatch, string type, string input,
 		        << gotStr << "<, expected >" << expectStr << "<" << endl;
 }
 
+/**
+ * @brief Read the files once directly and once by merging a @a MessageList per file,
+ * and check that both ways result in the same error and output.
+ * @param name the name of the check.
+ * @param contents the contents of the files to read in this order.
+ * @param count the number of files.
+ * @param templates the @a DataFieldTemplates to be referenced by name.
+ * @param expectResult the expected result of the failing file.
+ * @param expectText the text expected in the error output.
+ */
+void verifyMerge(const string name, const string contents[], const size_t count,
+		DataFieldTemplates* templates, const result_t expectResult, const string expectText)
+{
+	vector<string> filenames;
+	for (size_t i = 0; i < count; i++) {
+		ostringstream filename;
+		filename << "_merge" << i << ".csv";
+		ofstream ofs(filename.str().c_str());
+		ofs << contents[i];
+		ofs.close();
+		filenames.push_back(filename.str());
+	}
+
+	ostringstream directOutput, mergedOutput;
+	streambuf* coutBuf = cout.rdbuf(directOutput.rdbuf());
+	streambuf* cerrBuf = cerr.rdbuf(directOutput.rdbuf());
+	MessageMap direct;
+	result_t directResult = RESULT_OK;
+	for (size_t i = 0; directResult == RESULT_OK && i < count; i++)
+		directResult = direct.readFromFile(filenames[i], templates);
+
+	cout.rdbuf(mergedOutput.rdbuf());
+	cerr.rdbuf(mergedOutput.rdbuf());
+	vector<MessageList*> lists;
+	for (size_t i = 0; i < count; i++) {
+		lists.push_back(new MessageList(filenames[i]));
+		lists.back()->read(templates);
+	}
+	MessageMap merged;
+	result_t mergedResult = RESULT_OK;
+	for (size_t i = 0; i < count; i++) {
+		if (mergedResult == RESULT_OK)
+			mergedResult = merged.merge(*lists[i]);
+		delete lists[i];
+	}
+	cout.rdbuf(coutBuf);
+	cerr.rdbuf(cerrBuf);
+
+	for (size_t i = 0; i < count; i++)
+		remove(filenames[i].c_str());
+
+	if (directResult != expectResult)
+		cout << "merge " << name << " error: read " << getResultCode(directResult) << endl;
+	else if (mergedResult != directResult)
+		cout << "merge " << name << " error: merged " << getResultCode(mergedResult) << endl;
+	else if (directOutput.str().find(expectText) == string::npos)
+		cout << "merge " << name << " error: unexpected output >" << directOutput.str() << "<" << endl;
+	else if (mergedOutput.str() != directOutput.str())
+		cout << "merge " << name << " error: got >" << mergedOutput.str() << "<, expected >"
+				<< directOutput.str() << "<" << endl;
+	else if (merged.size() != direct.size())
+		cout << "merge " << name << " error: got " << merged.size() << " messages, expected " << direct.size() << endl;
+	else
+		cout << "merge " << name << " OK" << endl;
+}
+
 int main()
 {
 	// message= [type];class;name;[comment];[QQ];ZZ;PBSB;fields...
@@ -146,7 +213,7 @@ int main()
 			else
 				message = deleteMessage;
 		}
-		istringstream input(inputStr);
+		StringView input(inputStr);
 		SymbolString writeMstr;
 		if (message->isPassive() == true) {
 			ostringstream output;
@@ -162,6 +229,13 @@ int main()
 
 			bool match = inputStr == output.str();
 			verify(false, "decode", check[2] + "/" + check[3], match, inputStr, output.str());
+
+			// the value decoded on the first bus is not visible on another one
+			if (message->getLastUpdateTime() != 0 && message->getLastUpdateTime(1) == 0
+					&& message->getLastValue(1).empty() == true)
+				cout << "  \"" << inputStr << "\": other bus OK" << endl;
+			else
+				cout << "  \"" << inputStr << "\": other bus error" << endl;
 		} else {
 			result = message->prepareMaster(0xff, writeMstr, input);
 			if (failedPrepare == true) {
@@ -181,6 +255,13 @@ int main()
 
 			bool match = writeMstr==mstr;
 			verify(failedPrepareMatch, "prepare", inputStr, match, mstr.getDataStr(), writeMstr.getDataStr());
+
+			// prepare again for another destination (as done for scanning) from the prepared header
+			SymbolString otherMstr(check[2].substr(0, 2) + "fe" + check[2].substr(4));
+			input = StringView(inputStr);
+			result = message->prepareMaster(0xff, writeMstr, input, UI_FIELD_SEPARATOR, 0xfe);
+			match = result == RESULT_OK && writeMstr==otherMstr;
+			verify(failedPrepareMatch, "prepare other", inputStr, match, otherMstr.getDataStr(), writeMstr.getDataStr());
 		}
 	}
 
@@ -189,6 +270,38 @@ int main()
 		deleteMessage = NULL;
 	}
 
+	// prepare for destination addresses that need escaping from the prepared header
+	vector<unsigned char> id;
+	id.push_back(0x07);
+	id.push_back(0x04);
+	message = new Message("", "escaped", false, false, "", SYN, SYN, id, DataFieldSet::createIdentFields(), 0);
+	unsigned char dstAddresses[] = { SYN, ESC, 0x15, ESC };
+	for (size_t i = 0; i < sizeof(dstAddresses) / sizeof(dstAddresses[0]); i++) {
+		ostringstream master;
+		master << "ff" << hex << setw(2) << setfill('0') << static_cast<unsigned>(dstAddresses[i]) << "070400";
+		SymbolString expectMstr(master.str());
+		SymbolString writeMstr;
+		result = message->prepareMaster(0xff, writeMstr, StringView(), UI_FIELD_SEPARATOR, dstAddresses[i]);
+		verify(false, "prepare escaped", master.str(), result == RESULT_OK && writeMstr == expectMstr,
+				expectMstr.getDataStr(), writeMstr.getDataStr());
+	}
+	delete message;
+
+	// a duplicate name in a later file is reported with that file and line
+	string duplicate[] = {
+		"r,ehp,state,,,08,b509,0d2800,,,uch\n",
+		"# state again\nr,ehp,state,,,08,b509,0d2801,,,uch\n",
+	};
+	verifyMerge("duplicate", duplicate, 2, templates, RESULT_ERR_DUPLICATE,
+			"\"_merge1.csv\" line 2: " + string(getResultCode(RESULT_ERR_DUPLICATE)));
+
+	// the second type of a row fails with the invalid destination from its defaults
+	string multiType[] = {
+		"*r,ehp,,,,08\n*w,ehp,,,,aa\nr,,first,,,,b509,0d2800,,,uch\nr;w,,second,,,,b509,0d2900,,,uch\nr,,third,,,,b509,0d2a00,,,uch\n",
+	};
+	verifyMerge("multiple types", multiType, 1, templates, RESULT_ERR_INVALID_ARG,
+			"\"_merge0.csv\" line 4: " + string(getResultCode(RESULT_ERR_INVALID_ARG)));
+
 	delete templates;
 	delete messages;
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "rqueue.h"
+#include "thread.h"
+#include "capture.h"
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+/** the capacity of the tested queue. */
+#define QUEUE_SIZE 8
+
+/** the number of items passed from the producer to the consumer thread. */
+#define ITEMS 100000
+
+/** the time [us] to wait for an item that never arrives. */
+#define POP_TIMEOUT 50000
+
+/**
+ * @brief Pushes the numbers 0 to @a ITEMS-1 to the queue, retrying while it is full.
+ */
+class Producer : public Thread
+{
+public:
+
+	/**
+	 * @brief Construct a new instance.
+	 * @param queue the @a RQueue to push to.
+	 * @param delay the time [us] to wait before pushing the first item.
+	 */
+	Producer(RQueue<unsigned int, QUEUE_SIZE>& queue, const unsigned int delay)
+		: m_queue(queue), m_delay(delay) {}
+
+	// @copydoc
+	virtual void run()
+	{
+		usleep(m_delay);
+		for (unsigned int value = 0; value < ITEMS; value++)
+			while (m_queue.push(value) == false)
+				usleep(10);
+	}
+
+private:
+
+	/** the @a RQueue to push to. */
+	RQueue<unsigned int, QUEUE_SIZE>& m_queue;
+
+	/** the time [us] to wait before pushing the first item. */
+	const unsigned int m_delay;
+
+};
+
+int main()
+{
+	RQueue<unsigned int, QUEUE_SIZE> queue;
+	unsigned int value;
+
+	// wraparound: the positions pass the end of the ring many times
+	bool match = true;
+	unsigned int next = 0, expect = 0;
+	for (int round = 0; match == true && round < 20; round++) {
+		for (int i = 0; i < 5; i++)
+			match = queue.push(next++) == true;
+		for (int i = 0; match == true && i < 5; i++)
+			match = queue.pop(value, POP_TIMEOUT) == true && value == expect++;
+	}
+	if (match == true && queue.size() == 0)
+		cout << "wraparound OK" << endl;
+	else
+		cout << "wraparound error: item " << expect << endl;
+
+	// full queue: the producer does not block and keeps the queued items
+	for (unsigned int i = 0; i < QUEUE_SIZE; i++)
+		queue.push(i);
+	if (queue.push(QUEUE_SIZE) == false && queue.size() == QUEUE_SIZE)
+		cout << "full OK" << endl;
+	else
+		cout << "full error: size " << queue.size() << endl;
+	match = true;
+	for (unsigned int i = 0; match == true && i < QUEUE_SIZE; i++)
+		match = queue.pop(value, POP_TIMEOUT) == true && value == i;
+	if (match == true && queue.size() == 0)
+		cout << "drain OK" << endl;
+	else
+		cout << "drain error" << endl;
+
+	// timed-out pop on an empty queue
+	unsigned long long start = getMonotonicTime();
+	bool popped = queue.pop(value, POP_TIMEOUT);
+	unsigned long long duration = getMonotonicTime() - start;
+	if (popped == false && duration >= POP_TIMEOUT && duration < 10 * POP_TIMEOUT)
+		cout << "timeout OK" << endl;
+	else
+		cout << "timeout error: " << (popped ? "popped" : "waited") << " " << duration << " us" << endl;
+
+	// a waiting consumer is woken up by the producer thread, without losing or reordering items
+	Producer producer(queue, POP_TIMEOUT / 2);
+	producer.start("producer");
+	match = true;
+	for (expect = 0; match == true && expect < ITEMS; expect++)
+		match = queue.pop(value, 10 * POP_TIMEOUT) == true && value == expect;
+	producer.join();
+	if (match == true && queue.size() == 0)
+		cout << "threads OK" << endl;
+	else
+		cout << "threads error: item " << expect - 1 << endl;
+
+	return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "simulator.h"
+#include "port.h"
+#include "tcpsocket.h"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+/** the TCP port to serve the simulated bus on. */
+#define TEST_PORT 18751
+
+/** the device name for connecting to @a TEST_PORT. */
+#define TEST_DEVICE "127.0.0.1:18751"
+
+/** the duration [us] of a single symbol on the simulated bus. */
+#define TEST_SYMBOL_DURATION 500
+
+/** the max time [us] to wait for a single symbol. */
+#define TEST_TIMEOUT 100000
+
+/** the number of heap allocations done so far by the current thread. */
+static __thread unsigned int allocations = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+	allocations++;
+	void* ptr = malloc(size);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) throw()
+{
+	free(ptr);
+}
+
+/**
+ * @brief Receive symbols from the bus and compare them with the expected ones.
+ * @param port the @a Port to receive from.
+ * @param expected the expected escaped symbols.
+ * @return true if all symbols were received as expected.
+ */
+bool expect(Port& port, const SymbolString& expected)
+{
+	for (size_t pos = 0; pos < expected.size(); pos++) {
+		unsigned char symbol;
+		if (port.recv(TEST_TIMEOUT, 1, &symbol) != 1 || symbol != expected[pos])
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Wait for the next SYN symbol on the bus.
+ * @param port the @a Port to receive from.
+ * @return true if SYN was received in time.
+ */
+bool waitSyn(Port& port)
+{
+	for (int count = 0; count < 100; count++) {
+		unsigned char symbol;
+		if (port.recv(TEST_TIMEOUT, 1, &symbol) != 1)
+			return false;
+		if (symbol == SYN)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Send a master telegram after SYN and check the echo, the ACK, and the slave answer.
+ * @param port the @a Port to send to and receive from.
+ * @param master the unescaped master data without CRC.
+ * @param slave the unescaped slave data without CRC, or the empty string if no answer is expected.
+ */
+void exchange(Port& port, const string master, const string slave)
+{
+	SymbolString command(master);
+	SymbolString ack, syn;
+	ack.push_back(ACK, false);
+	syn.push_back(SYN, false);
+
+	if (waitSyn(port) == false) {
+		cout << "\"" << master << "\": SYN error" << endl;
+		return;
+	}
+	if (port.send(command.data(), command.size()) != (ssize_t)command.size()) {
+		cout << "\"" << master << "\": send error" << endl;
+		return;
+	}
+	if (expect(port, command) == false) {
+		cout << "\"" << master << "\": echo error" << endl;
+		return;
+	}
+	if (slave.length() == 0) {
+		// nobody acknowledges, so the AUTO-SYN generator takes over
+		if (expect(port, syn) == true)
+			cout << "\"" << master << "\": no answer OK" << endl;
+		else
+			cout << "\"" << master << "\": no answer error" << endl;
+		return;
+	}
+	if (expect(port, ack) == false) {
+		cout << "\"" << master << "\": ACK error" << endl;
+		return;
+	}
+	if (expect(port, SymbolString(slave)) == false) {
+		cout << "\"" << master << "\": answer error" << endl;
+		return;
+	}
+	cout << "\"" << master << "\": answer OK" << endl;
+
+	// acknowledge the answer and release the bus
+	unsigned char end[] = { ACK, SYN };
+	port.send(end, sizeof(end));
+	SymbolString echo;
+	echo.push_back(ACK, false);
+	echo.push_back(SYN, false);
+	if (expect(port, echo) == false)
+		cout << "\"" << master << "\": release error" << endl;
+}
+
+/**
+ * @brief Receive a telegram part symbol by symbol the way the @a BusHandler does.
+ * @param port the @a Port to receive from.
+ * @param data the @a SymbolString to append the unescaped symbols to.
+ * @param headerLen the index of the length byte in @a data.
+ * @return true if the part was received completely with valid CRC.
+ */
+bool receivePart(Port& port, SymbolString& data, const unsigned char headerLen)
+{
+	for (;;) {
+		unsigned char symbol;
+		if (port.recv(TEST_TIMEOUT, 1, &symbol) != 1)
+			return false;
+		size_t crcPos = data.size() > headerLen ? headerLen + 1 + data[headerLen] : 0xff;
+		result_t result = data.push_back(symbol, true, data.size() < crcPos);
+		if (result < RESULT_OK)
+			return false;
+		if (result == RESULT_OK && crcPos != 0xff && data.size() == crcPos + 1)
+			return data[crcPos] == data.getCRC();
+	}
+}
+
+/**
+ * @brief Send a read message and receive the answer with the same calls as the @a BusHandler.
+ * @param port the @a Port to send to and receive from.
+ * @param messages the @a MessageMap for looking up the received command.
+ * @param message the @a Message to send.
+ * @return true if the telegram was completed and decoded successfully.
+ */
+bool sendTelegram(Port& port, MessageMap* messages, Message* message)
+{
+	SymbolString master;
+	if (message->prepareMaster(0xff, master) != RESULT_OK || waitSyn(port) == false)
+		return false;
+	if (port.send(master.data(), master.size()) != (ssize_t)master.size())
+		return false;
+
+	SymbolString command, response;
+	unsigned char symbol;
+	if (port.recv(TEST_TIMEOUT, 1, &symbol) != 1 || command.push_back(symbol, false) != RESULT_OK)
+		return false;
+	if (receivePart(port, command, 4) == false || messages->find(command, true) != message)
+		return false;
+	if (port.recv(TEST_TIMEOUT, 1, &symbol) != 1 || symbol != ACK)
+		return false;
+	if (receivePart(port, response, 0) == false)
+		return false;
+
+	unsigned char end[] = { ACK, SYN };
+	if (port.send(end, sizeof(end)) != sizeof(end))
+		return false;
+	return message->decode(pt_slaveData, response) == RESULT_OK;
+}
+
+int main()
+{
+	DataFieldTemplates* templates = new DataFieldTemplates();
+	MessageMap* messages = new MessageMap();
+	string definitions[] = {
+		"r,ehp,state,,,08,b509,0d2800,,,uch",
+		"r,ehp,date,,,08,b509,0d29,,,bda",
+		"u,ehp,power,,,08,b509,29ba00,,,uch",
+	};
+	for (size_t i = 0; i < sizeof(definitions) / sizeof(definitions[0]); i++) {
+		istringstream isstr(definitions[i]);
+		string item;
+		vector<string> entries;
+		while (getline(isstr, item, FIELD_SEPARATOR) != 0)
+			entries.push_back(item);
+		vector<string>::iterator it = entries.begin();
+		Message* message = NULL;
+		result_t result = Message::create(it, entries.end(), NULL, templates, message);
+		if (result == RESULT_OK)
+			result = messages->add(message);
+		if (result != RESULT_OK) {
+			cout << "\"" << definitions[i] << "\": create error: " << getResultCode(result) << endl;
+			if (message != NULL)
+				delete message;
+		}
+	}
+
+	TCPServer server(TEST_PORT, "127.0.0.1");
+	if (server.start() != 0) {
+		cout << "listen error" << endl;
+		return 1;
+	}
+	Port port(TEST_DEVICE, true, false, NULL, false, "", 0);
+	result_t result = port.open();
+	TCPSocket* socket = result == RESULT_OK ? server.newSocket() : NULL;
+	if (socket == NULL) {
+		cout << "open error: " << getResultCode(result) << endl;
+		return 1;
+	}
+
+	Simulator simulator(socket->getFD(), messages, TEST_SYMBOL_DURATION);
+	simulator.addSlave(0x08);
+	simulator.start("simulator");
+
+	// identification of a simulated slave
+	exchange(port, "ff08070400", "0a0053494d554c01000100");
+	// read messages of the configuration, found with the active ID lengths only
+	exchange(port, "ff08b509030d2800", "0100");
+	exchange(port, "ff08b509020d29", "0400000000");
+	// passive message and unknown slave are not answered
+	exchange(port, "ff08b5090329ba00", "");
+	exchange(port, "ff15070400", "");
+
+	// complete telegrams without touching the heap after the first one
+	Message* message = messages->find("ehp", "state", false);
+	bool completed = message != NULL && sendTelegram(port, messages, message);
+	unsigned int before = allocations;
+	for (int i = 0; completed == true && i < 3; i++)
+		completed = sendTelegram(port, messages, message);
+	unsigned int count = allocations - before;
+	if (completed == false)
+		cout << "telegram error" << endl;
+	else if (count == 0)
+		cout << "allocation free OK" << endl;
+	else
+		cout << "allocation free error: got " << count << " allocations" << endl;
+
+	simulator.stop();
+	simulator.join();
+
+	const SimulatorStats& stats = simulator.getStats();
+	if (stats.clientTelegrams == 9 && stats.answered == 7)
+		cout << "stats OK" << endl;
+	else
+		cout << "stats error: " << stats.clientTelegrams << " telegrams, " << stats.answered << " answered" << endl;
+
+	port.close();
+	delete socket;
+	delete messages;
+	delete templates;
+
+	return 0;
+}
@@ -20,9 +20,27 @@
 #include "symbol.h"
 #include <iostream>
 #include <iomanip>
+#include <new>
 
 using namespace std;
 
+/** the number of heap allocations done so far. */
+static unsigned int allocations = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+	allocations++;
+	void* ptr = malloc(size);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) throw()
+{
+	free(ptr);
+}
+
 int main ()
 {
 	SymbolString sstr("10feb5050427a915aa");
@@ -65,6 +83,137 @@ int main ()
 		std::cout << "ctor unescaped error: got " << gotStr << ", expected "
 		        << expectStr << std::endl;
 
+	// receive, convert and copy a telegram like the BusHandler does
+	const unsigned char telegram[] = { 0x10, 0xfe, 0xb5, 0x05, 0x04, 0x27, 0xa9, 0x00, 0x15, 0xa9, 0x01, 0x77 };
+	unsigned int before = allocations;
+	SymbolString command, response;
+	for (size_t i = 0; i < sizeof(telegram); i++)
+		command.push_back(telegram[i], true, i + 1 < sizeof(telegram));
+	SymbolString escaped(command, true, false);
+	response = escaped;
+	response.swap(command);
+	bool swapped = command == escaped && response.size() == 10;
+	response.clear();
+	unsigned int count = allocations - before;
+
+	if (count == 0 && swapped == true && response.size() == 0)
+		std::cout << "allocation free OK" << std::endl;
+	else
+		std::cout << "allocation free error: got " << std::dec << count << " allocations" << std::endl;
+
+	SymbolString full;
+	result_t result = RESULT_OK;
+	for (size_t i = 0; result == RESULT_OK && i <= MAX_SYMBOLS; i++)
+		result = full.push_back(0x01, false, false);
+
+	if (result == RESULT_ERR_OVERFLOW && full.size() == MAX_SYMBOLS)
+		std::cout << "overflow OK" << std::endl;
+	else
+		std::cout << "overflow error: got " << getResultCode(result) << std::endl;
+
+	SymbolString resized;
+	resized.push_back(0x10, false, false);
+	result = resized.resize(MAX_SYMBOLS + 1);
+	if (result == RESULT_ERR_OVERFLOW && resized.size() == 1)
+		result = resized.resize(3);
+	if (result == RESULT_OK && resized.getDataStr(false) == "100000")
+		std::cout << "resize OK" << std::endl;
+	else
+		std::cout << "resize error: got " << getResultCode(result) << ", " << resized.getDataStr(false) << std::endl;
+
+	// compare bulk CRC with symbol wise CRC
+	srand(1);
+	bool crcMatch = true;
+	for (size_t len = 0; crcMatch == true && len <= 2 * MAX_DATA_LENGTH; len++) {
+		SymbolString unescaped;
+		unsigned char buf[2 * MAX_DATA_LENGTH];
+		for (size_t i = 0; i < len; i++) {
+			buf[i] = (unsigned char)(rand() % 4 == 0 ? ESC + rand() % 2 : rand());
+			unescaped.push_back(buf[i], false, true);
+		}
+		SymbolString escapedStr(unescaped, true, false);
+		crcMatch = calcCrc(buf, len, false) == unescaped.getCRC()
+			&& escapedStr.getCRC() == unescaped.getCRC()
+			&& escapedStr.calcCrc() == unescaped.getCRC()
+			&& unescaped.calcCrc() == unescaped.getCRC()
+			&& calcCrc(escapedStr.data(), escapedStr.size()) == escapedStr.getCRC();
+		if (crcMatch == false)
+			std::cout << "bulk CRC error: length " << std::dec << len << std::endl;
+	}
+	if (crcMatch == true)
+		std::cout << "bulk CRC OK" << std::endl;
+
+	// compare bulk escape/unescape with symbol wise conversion
+	bool convertMatch = true;
+	for (size_t len = 0; convertMatch == true && len <= 2 * MAX_DATA_LENGTH; len++) {
+		unsigned char buf[2 * MAX_DATA_LENGTH];
+		SymbolString unescaped, unescapedAgain;
+		ostringstream expectEscaped;
+		for (size_t i = 0; i < len; i++) {
+			buf[i] = (unsigned char)(rand() % 4 == 0 ? ESC + rand() % 2 : rand());
+			unescaped.push_back(buf[i], false, false);
+			if (buf[i] == ESC || buf[i] == SYN)
+				expectEscaped << "a90" << (buf[i] == SYN ? 1 : 0);
+			else
+				expectEscaped << std::hex << std::setw(2) << std::setfill('0') << (unsigned int)buf[i];
+		}
+		SymbolString bulkEscaped(unescaped, true, false);
+		SymbolString bulkUnescaped(bulkEscaped, false, false);
+		for (size_t i = 0; i < bulkEscaped.size(); i++)
+			unescapedAgain.push_back(bulkEscaped[i], true, false);
+		convertMatch = bulkUnescaped == unescaped && unescapedAgain == unescaped
+			&& bulkEscaped.getDataStr(false) == expectEscaped.str();
+		if (convertMatch == false)
+			std::cout << "bulk escape error: length " << std::dec << len << std::endl;
+	}
+	if (convertMatch == true)
+		std::cout << "bulk escape OK" << std::endl;
+
+	// append unescaped symbols within an escape sequence
+	const unsigned char escStart[] = { ESC }, plain[] = { 0x10 };
+	SymbolString inEsc;
+	result = inEsc.append(escStart, sizeof(escStart));
+	if (result == RESULT_IN_ESC)
+		result = inEsc.append(plain, sizeof(plain), false);
+	if (result == RESULT_ERR_ESC && inEsc.size() == 0)
+		std::cout << "unescaped within escape OK" << std::endl;
+	else
+		std::cout << "unescaped within escape error: got " << getResultCode(result) << std::endl;
+
+	// overflow in the remainder after an invalid escape sequence
+	const unsigned char invalidEsc[] = { ESC, 0x05, 0x00, 0x10 };
+	SymbolString almostFull;
+	for (size_t i = 0; i + 1 < MAX_SYMBOLS; i++)
+		almostFull.push_back(0x01, false, false);
+	result = almostFull.append(invalidEsc, sizeof(invalidEsc));
+	if (result == RESULT_ERR_OVERFLOW && almostFull.size() == MAX_SYMBOLS)
+		std::cout << "invalid escape overflow OK" << std::endl;
+	else
+		std::cout << "invalid escape overflow error: got " << getResultCode(result) << std::endl;
+
+	// parse invalid hex strings
+	const char* invalidHex[] = { "10f", "10fg", "1 fe", "0x10" };
+	bool invalidMatch = true;
+	for (size_t i = 0; i < sizeof(invalidHex) / sizeof(invalidHex[0]); i++) {
+		SymbolString parsed;
+		parsed.push_back(0x10, false, false);
+		result = parsed.parseHex(invalidHex[i]);
+		if (result != RESULT_ERR_INVALID_ARG || parsed.size() != 1) {
+			std::cout << "invalid hex error: " << invalidHex[i] << " got " << getResultCode(result) << std::endl;
+			invalidMatch = false;
+		}
+	}
+	if (invalidMatch == true)
+		std::cout << "invalid hex OK" << std::endl;
+
+	char hexStr[2*MAX_SYMBOLS+1];
+	sstr = SymbolString("10FEB5050427A915AA");
+	size_t hexLen = sstr.getDataStr(hexStr);
+	if (hexLen == 20 && strcmp(hexStr, "10feb5050427a915aa77") == 0 && sstr.getDataStr() == hexStr)
+		std::cout << "hex buffer OK" << std::endl;
+	else
+		std::cout << "hex buffer error: got " << hexStr << std::endl;
+
 	return 0;
 
 }
@@ -173,7 +173,8 @@ void Appl::setOptVal(const char* option, const string value, DataType datatype)
 		m_optvals[option] = static_cast<float>(strtod(value.c_str(), NULL));
 		break;
 	case dt_string:
-		m_optvals[option] = value.c_str();
+		m_stringVals.push_back(value);
+		m_optvals[option] = m_stringVals.back().c_str();
 		break;
 	default:
 		break;
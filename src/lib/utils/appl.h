@@ -23,6 +23,7 @@
 #include <string>
 #include <cstring>
 #include <map>
+#include <list>
 #include <vector>
 
 using namespace std;
@@ -229,6 +230,9 @@ private:
 	/** map option - value iterator */
 	map<const char*, OptVal>::iterator ov_it;
 
+	/** the storage for string option values referenced by @a m_optvals */
+	list<string> m_stringVals;
+
 	/** given arguments */
 	vector<string> m_argv;
 
@@ -202,6 +202,15 @@ void Logger::log(const int area, const int level, const string& data, ...)
 
 }
 
+bool Logger::isLogged(const int area, const int level) const
+{
+	for (sink_t::const_iterator iter = m_sinks.begin(); iter != m_sinks.end(); ++iter)
+		if (*iter != 0 && ((*iter)->getAreas() & area) != 0 && (*iter)->getLevel() >= level)
+			return true;
+
+	return false;
+}
+
 void Logger::run()
 {
 	bool running = true;
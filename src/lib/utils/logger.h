@@ -284,6 +284,14 @@ public:
 	 */
 	void log(const int area, const int level, const string& text, ...);
 
+	/**
+	 * @brief returns whether a message with the area and level would be written by any sink.
+	 * @param area the logging area of the message.
+	 * @param level the logging level of the message.
+	 * @return true if any sink would write the message.
+	 */
+	bool isLogged(const int area, const int level) const;
+
 	/**
 	 * @brief returns the sink at the specified index.
 	 * @param index the index of the sink to return.
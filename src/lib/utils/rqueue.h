@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef LIBUTILS_RQUEUE_H_
+#define LIBUTILS_RQUEUE_H_
+
+#include <time.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/**
+ * @brief lock-free ring queue template for exactly one producer and one consumer thread.
+ * The producer never blocks. The consumer may wait for new items, in which case
+ * it is woken up via futex (or a condition variable on non Linux systems).
+ * @param T the item type.
+ * @param SIZE the capacity of the queue (has to be a power of two).
+ */
+template <typename T, unsigned int SIZE>
+class RQueue
+{
+
+public:
+	/**
+	 * @brief constructs a new instance.
+	 */
+	RQueue() : m_head(0), m_tail(0), m_waiting(0)
+	{
+#ifndef __linux__
+		pthread_mutex_init(&m_mutex, NULL);
+		pthread_cond_init(&m_cond, NULL);
+#endif
+	}
+
+	/**
+	 * @brief destructor.
+	 */
+	~RQueue()
+	{
+#ifndef __linux__
+		pthread_mutex_destroy(&m_mutex);
+		pthread_cond_destroy(&m_cond);
+#endif
+	}
+
+	/**
+	 * @brief add a new item to the end of queue (producer only).
+	 * @param item to add.
+	 * @return true if the item was added, false if the queue is full.
+	 */
+	bool push(const T& item)
+	{
+		unsigned int tail = m_tail;
+		if (tail - __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) >= SIZE)
+			return false;
+
+		m_items[tail % SIZE] = item;
+		__atomic_store_n(&m_tail, tail + 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&m_waiting, __ATOMIC_SEQ_CST) != 0)
+			wake();
+
+		return true;
+	}
+
+	/**
+	 * @brief remove the first item from queue (consumer only).
+	 * @param item the variable in which to store the item.
+	 * @param timeout max time to wait for an item [usec], or 0 for infinite.
+	 * @return true if an item was removed, false if the timeout was reached.
+	 */
+	bool pop(T& item, const long timeout)
+	{
+		unsigned int head = m_head;
+		if (__atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) == head && wait(head, timeout) == false)
+			return false;
+
+		item = m_items[head % SIZE];
+		__atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	/**
+	 * @brief the number of entries inside queue.
+	 * @return the size.
+	 */
+	unsigned int size()
+	{
+		return __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+	}
+
+private:
+	/**
+	 * @brief wait until the producer added an item.
+	 * @param head the current head position.
+	 * @param timeout max time to wait [usec], or 0 for infinite.
+	 * @return true if an item is available, false if the timeout was reached.
+	 */
+	bool wait(const unsigned int head, const long timeout)
+	{
+		struct timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout / 1000000;
+		deadline.tv_nsec += (timeout % 1000000) * 1000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		bool available = false;
+		__atomic_store_n(&m_waiting, 1, __ATOMIC_SEQ_CST);
+		while (true) {
+			unsigned int tail = __atomic_load_n(&m_tail, __ATOMIC_SEQ_CST);
+			if (tail != head) {
+				available = true;
+				break;
+			}
+			struct timespec remain, now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			remain.tv_sec = deadline.tv_sec - now.tv_sec;
+			remain.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+			if (remain.tv_nsec < 0) {
+				remain.tv_sec--;
+				remain.tv_nsec += 1000000000;
+			}
+			if (timeout > 0 && remain.tv_sec < 0)
+				break;
+
+#ifdef __linux__
+			syscall(SYS_futex, &m_tail, FUTEX_WAIT_PRIVATE, tail, timeout > 0 ? &remain : NULL, NULL, 0);
+#else
+			pthread_mutex_lock(&m_mutex);
+			if (__atomic_load_n(&m_tail, __ATOMIC_SEQ_CST) == tail) {
+				if (timeout > 0) {
+					struct timespec abstime;
+					clock_gettime(CLOCK_REALTIME, &abstime);
+					abstime.tv_sec += remain.tv_sec;
+					abstime.tv_nsec += remain.tv_nsec;
+					if (abstime.tv_nsec >= 1000000000) {
+						abstime.tv_sec++;
+						abstime.tv_nsec -= 1000000000;
+					}
+					pthread_cond_timedwait(&m_cond, &m_mutex, &abstime);
+				}
+				else
+					pthread_cond_wait(&m_cond, &m_mutex);
+			}
+			pthread_mutex_unlock(&m_mutex);
+#endif
+		}
+		__atomic_store_n(&m_waiting, 0, __ATOMIC_SEQ_CST);
+
+		return available;
+	}
+
+	/**
+	 * @brief wake up the waiting consumer.
+	 */
+	void wake()
+	{
+#ifdef __linux__
+		syscall(SYS_futex, &m_tail, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+		pthread_mutex_lock(&m_mutex);
+		pthread_cond_signal(&m_cond);
+		pthread_mutex_unlock(&m_mutex);
+#endif
+	}
+
+	/** the items */
+	T m_items[SIZE];
+
+	/** the position of the next item to remove (only written by the consumer) */
+	unsigned int m_head;
+
+	/** the position of the next item to add (only written by the producer, also used as futex word) */
+	unsigned int m_tail;
+
+	/** whether the consumer is waiting for new items */
+	int m_waiting;
+
+#ifndef __linux__
+	/** mutex variable for the wake up */
+	pthread_mutex_t m_mutex;
+
+	/** condition variable for the wake up */
+	pthread_cond_t m_cond;
+#endif
+
+};
+
+#endif // LIBUTILS_RQUEUE_H_
@@ -23,6 +23,7 @@
 
 #include "appl.h"
 #include "port.h"
+#include "capture.h"
 #include <iostream>
 #include <cstdlib>
 #include <fstream>
@@ -42,7 +43,8 @@ void define_args()
 		  "             for example: 'ln -s /dev/pts/2 /dev/ttyUSB60'\n"
 		  "                          'ln -s /dev/pts/3 /dev/ttyUSB20'\n"
 		  "          3. start ebusd: 'ebusd -f -d /dev/ttyUSB20'\n"
-		  "          4. start ebusfeed: 'ebusfeed /path/to/ebus_dump.bin'\n\n"
+		  "          4. start ebusfeed: 'ebusfeed /path/to/ebus_dump.bin'\n"
+		  "   Dump files in capture format are sent with their original timing.\n\n"
 		  "Command: '/path/to/ebus_dump.bin'\n\n"
 		  "Options:\n");
 
@@ -52,6 +54,51 @@ void define_args()
 	A.addOption("time", "t", OptVal(10000), dt_long, ot_mandatory,
 		    "delay between 2 bytes in 'us' (10000)");
 
+	A.addOption("start", "s", OptVal(0), dt_long, ot_mandatory,
+		    "skip the first seconds of a capture file (0)");
+
+	A.addOption("print", "p", OptVal(false), dt_bool, ot_none,
+		    "only print the dump file without sending");
+
+}
+
+/**
+ * @brief Print and optionally send the received symbols of a capture file with their original timing.
+ * @param reader the opened @a CaptureReader.
+ * @param port the @a Port to send to, or NULL to only print.
+ */
+void feedCapture(CaptureReader& reader, Port* port)
+{
+	unsigned long long start = reader.getStartTime() + A.getOptVal<long>("start") * 1000000ULL;
+	if (start > reader.getStartTime())
+		reader.seek(start);
+
+	unsigned char data[CAPTURE_MAX_RECORD];
+	unsigned long long time, last = 0;
+	bool sent;
+	size_t count;
+	while (reader.next(time, sent, data, count) == RESULT_OK) {
+		if (time < start)
+			continue;
+
+		if (port != NULL && sent == false && last > 0 && time > last) {
+			struct timespec delay;
+			delay.tv_sec = (time - last) / 1000000;
+			delay.tv_nsec = (time - last) % 1000000 * 1000;
+			nanosleep(&delay, NULL);
+		}
+
+		cout << dec << fixed << setprecision(3) << (time - reader.getStartTime()) / 1000.0
+		     << (sent == true ? " S " : " R ");
+		for (size_t pos = 0; pos < count; pos++)
+			cout << hex << setw(2) << setfill('0') << static_cast<unsigned>(data[pos]);
+		cout << setfill(' ') << endl;
+
+		if (port != NULL && sent == false) {
+			port->send(data, count);
+			last = time;
+		}
+	}
 }
 
 int main(int argc, char* argv[])
@@ -69,35 +116,47 @@ int main(int argc, char* argv[])
 
 	string dev(A.getOptVal<const char*>("device"));
 	Port port(dev, true, false, NULL, false, "", 1);
+	bool print = A.getOptVal<bool>("print");
 
-	port.open();
-	if(port.isOpen() == true) {
+	if (print == false) {
+		port.open();
+		if (port.isOpen() == false) {
+			cout << "error opening device " << A.getOptVal<const char*>("device") << endl;
+			exit(EXIT_FAILURE);
+		}
 		cout << "openPort successful." << endl;
+	}
 
+	CaptureReader reader;
+	result_t result = reader.open(A.getCommand());
+	if (result == RESULT_OK) {
+		feedCapture(reader, print == true ? NULL : &port);
+		reader.close();
+	}
+	else if (result == RESULT_ERR_INVALID_ARG) {
 		fstream file(A.getCommand().c_str(), ios::in | ios::binary);
 
-		if (file.is_open() == true) {
-
-			while (file.eof() == false) {
-				unsigned char byte = file.get();
-				cout << hex << setw(2) << setfill('0')
-				     << static_cast<unsigned>(byte) << endl;
+		while (file.eof() == false) {
+			unsigned char byte = file.get();
+			cout << hex << setw(2) << setfill('0')
+			     << static_cast<unsigned>(byte) << endl;
 
+			if (print == false) {
 				port.send(&byte, 1);
 				usleep(A.getOptVal<long>("time"));
 			}
-
-			file.close();
 		}
-		else
-			cout << "error opening file " << A.getOptVal<const char*>("file") << endl;
 
+		file.close();
+	}
+	else
+		cout << "error opening file " << A.getCommand() << endl;
+
+	if (print == false) {
 		port.close();
 		if(port.isOpen() == false)
 			cout << "closePort successful." << endl;
-	} else
-		cout << "error opening device " << A.getOptVal<const char*>("device") << endl;
-
+	}
 
 	exit(EXIT_SUCCESS);
 }
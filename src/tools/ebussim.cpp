@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) John Baier 2014 <ebusd@johnm.de>
+ *
+ * This file is part of ebusd.
+ *
+ * ebusd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ebusd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ebusd. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "appl.h"
+#include "simulator.h"
+#include "tcpsocket.h"
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+
+using namespace std;
+
+Appl& A = Appl::Instance(false);
+
+/** whether a signal was received to stop the simulation. */
+static volatile bool stopped = false;
+
+void define_args()
+{
+	A.setVersion("ebussim is part of " PACKAGE_STRING);
+
+	A.addText(" 'ebussim' simulates an eBUS with AUTO-SYN generator, slaves and competing masters\n\n"
+		  "   Usage: 1. start ebussim: 'ebussim -m 03:500 -s 08,15'\n"
+		  "          2. start ebusd on the printed pty: 'ebusd -f -n -d /dev/pts/N'\n"
+		  "             or with '-p 9999': 'ebusd -f -d localhost:9999'\n"
+		  "   Statistics are printed when the simulation ends.\n\n"
+		  "Options:\n");
+
+	A.addOption("port", "p", OptVal(0), dt_int, ot_mandatory,
+		    "serve the bus on this TCP port instead of a pty (0)");
+
+	A.addOption("ebusconfdir", "e", OptVal(""), dt_string, ot_mandatory,
+		    "directory with message definitions answered by slaves");
+
+	A.addOption("slaves", "s", OptVal("08"), dt_string, ot_mandatory,
+		    "comma separated hex slave addresses (08)");
+
+	A.addOption("masters", "m", OptVal(""), dt_string, ot_mandatory,
+		    "comma separated hex master addresses with mean interval in ms\n"
+		    "\t\t\tbetween telegrams, e.g. '03:500,10:2000'");
+
+	A.addOption("nakrate", "", OptVal(0.0f), dt_float, ot_mandatory,
+		    "percentage of commands answered with NAK (0)");
+
+	A.addOption("crcrate", "", OptVal(0.0f), dt_float, ot_mandatory,
+		    "percentage of responses sent with wrong CRC (0)");
+
+	A.addOption("speed", "", OptVal(1.0f), dt_float, ot_mandatory,
+		    "speed factor of the bus relative to 2400Bd (1)");
+
+	A.addOption("seed", "", OptVal(1), dt_int, ot_mandatory,
+		    "seed for random decisions (1)");
+
+	A.addOption("time", "t", OptVal(0), dt_int, ot_mandatory,
+		    "end simulation after seconds, 0 for endless (0)");
+
+}
+
+/**
+ * @brief Signal handler for stopping the simulation.
+ * @param sig the received signal.
+ */
+void signal_handler(int sig)
+{
+	(void)sig;
+	stopped = true;
+}
+
+/**
+ * @brief Read all message definitions from a directory and its subdirectories.
+ * @param path the directory.
+ * @param templates the @a DataFieldTemplates.
+ * @param messages the @a MessageMap to fill.
+ * @return @a RESULT_OK on success, or an error code.
+ */
+result_t readConfigFiles(const string path, DataFieldTemplates* templates, MessageMap* messages)
+{
+	vector<MessageList*> lists;
+	result_t result = MessageList::collect(path, ".csv", lists);
+	MessageList::readAll(lists, templates);
+
+	for (vector<MessageList*>::iterator it = lists.begin(); it != lists.end(); it++) {
+		if (result == RESULT_OK)
+			result = messages->merge(**it);
+		delete *it;
+	}
+	return result;
+}
+
+/**
+ * @brief Run a simulation on the file descriptor until it ends.
+ * @param fd the file descriptor to serve the bus to.
+ * @param messages the @a MessageMap, or NULL.
+ * @return true if the simulation was stopped by signal or time.
+ */
+bool simulate(const int fd, MessageMap* messages)
+{
+	Simulator simulator(fd, messages, (long)(SIM_SYMBOL_DURATION / A.getOptVal<float>("speed")),
+		A.getOptVal<int>("seed"));
+	simulator.setErrorRates(A.getOptVal<float>("nakrate") / 100, A.getOptVal<float>("crcrate") / 100);
+
+	string slaves = A.getOptVal<const char*>("slaves");
+	for (size_t pos = 0; pos < slaves.length(); ) {
+		simulator.addSlave((unsigned char)strtoul(slaves.c_str() + pos, NULL, 16));
+		pos = slaves.find(',', pos);
+		if (pos != string::npos)
+			pos++;
+	}
+	string masters = A.getOptVal<const char*>("masters");
+	for (size_t pos = 0; pos < masters.length(); ) {
+		char* end;
+		unsigned char address = (unsigned char)strtoul(masters.c_str() + pos, &end, 16);
+		unsigned int interval = *end == ':' ? strtoul(end + 1, NULL, 10) : 1000;
+		simulator.addMaster(address, interval);
+		pos = masters.find(',', pos);
+		if (pos != string::npos)
+			pos++;
+	}
+
+	time_t end = A.getOptVal<int>("time") > 0 ? time(NULL) + A.getOptVal<int>("time") : 0;
+	simulator.start("simulator");
+	do {
+		usleep(100000);
+	} while (stopped == false && simulator.isRunning() == true && (end == 0 || time(NULL) < end));
+	bool result = simulator.isRunning();
+	simulator.stop();
+	simulator.join();
+
+	const SimulatorStats& stats = simulator.getStats();
+	cout << "symbols: " << stats.symbols << ", AUTO-SYN: " << stats.syns
+	     << ", collisions: " << stats.collisions << endl
+	     << "client telegrams: " << stats.clientTelegrams << ", lost arbitrations: " << stats.clientLost << endl
+	     << "master telegrams: " << stats.masterTelegrams << ", answered: " << stats.answered << endl
+	     << "injected NAKs: " << stats.naks << ", injected CRC errors: " << stats.crcErrors << endl;
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	// define arguments and application variables
+	define_args();
+
+	// parse arguments
+	A.parseArgs(argc, argv);
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	MessageMap* messages = NULL;
+	DataFieldTemplates templates;
+	string confdir = A.getOptVal<const char*>("ebusconfdir");
+	if (confdir.length() > 0) {
+		messages = new MessageMap();
+		templates.readFromFile(confdir + "/_types.csv");
+		result_t result = readConfigFiles(confdir, &templates, messages);
+		if (result != RESULT_OK) {
+			cout << "error reading config files: " << getResultCode(result) << endl;
+			exit(EXIT_FAILURE);
+		}
+		cout << "message DB: " << messages->size() << endl;
+	}
+
+	if (A.getOptVal<int>("port") > 0) {
+		TCPServer server(A.getOptVal<int>("port"), "0.0.0.0");
+		if (server.start() != 0) {
+			cout << "error listening on port " << A.getOptVal<int>("port") << endl;
+			exit(EXIT_FAILURE);
+		}
+		cout << "virtual bus: localhost:" << A.getOptVal<int>("port") << endl;
+		while (stopped == false) {
+			struct pollfd fds;
+			fds.fd = server.getFD();
+			fds.events = POLLIN;
+			if (poll(&fds, 1, 1000) <= 0)
+				continue;
+			TCPSocket* socket = server.newSocket();
+			if (socket == NULL)
+				continue;
+			bool done = simulate(socket->getFD(), messages);
+			delete socket;
+			if (done == true)
+				break;
+		}
+	}
+	else {
+		int fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+			cout << "error creating pty" << endl;
+			exit(EXIT_FAILURE);
+		}
+		// raw mode without echo, otherwise the simulated symbols would come back as client symbols
+		struct termios tio;
+		if (tcgetattr(fd, &tio) == 0) {
+			cfmakeraw(&tio);
+			tcsetattr(fd, TCSANOW, &tio);
+		}
+		cout << "virtual bus: " << ptsname(fd) << endl;
+		simulate(fd, messages);
+		close(fd);
+	}
+
+	if (messages != NULL)
+		delete messages;
+
+	exit(EXIT_SUCCESS);
+}